@@ -3,6 +3,7 @@
 #include <inttypes.h>
 #include <round.h>
 #include <stdio.h>
+#include "intrinsic.h"
 #include "threads/interrupt.h"
 #include "threads/io.h"
 #include "threads/synch.h"
@@ -20,26 +21,53 @@
 /* Number of timer ticks since OS booted. */
 static int64_t ticks;
 
-/* Number of loops per timer tick.
-   Initialized by timer_calibrate(). */
-static unsigned loops_per_tick;
+/* 틱 하나에 해당하는 8254 카운트. */
+static uint16_t tick_count;
+
+/* tickless idle: idle 스레드가 PIT를 one-shot으로 건 틱 수. 0이면 주기 모드입니다.
+ * 그동안 틱마다 오던 인터럽트는 오지 않고, one-shot 인터럽트나 thread_unblock()이
+ * 건너뛴 틱을 한꺼번에 따라잡은 뒤 주기 모드로 되돌립니다. 인터럽트를 끈 상태에서만 건드립니다.
+ * 1은 일찍 깨어난 뒤 지금 틱의 남은 부분만 one-shot으로 건 상태로, 다음 인터럽트에서 주기 모드로 돌아갑니다. */
+static int64_t oneshot_ticks;
+
+/* 8254 입력 주파수. */
+#define PIT_HZ 1193180
+
+#define NS_PER_SEC 1000000000LL
+#define NS_PER_TICK (NS_PER_SEC / TIMER_FREQ)
+
+/* TSC 보정에 쓰는 틱 수 (약 0.1초). */
+#define TSC_CALIBRATE_TICKS (TIMER_FREQ / 10)
+
+/* 나노초 시계: 보정을 마친 시점(tsc_base, nanos_base)부터 흐른 TSC 클럭을 tsc_hz로 나누어 셉니다.
+   timer_calibrate()가 PIT에 맞춰 tsc_hz를 정하기 전에는 틱으로 셉니다. */
+static uint64_t tsc_hz;
+static uint64_t tsc_base;
+static int64_t nanos_base;
 
 static intr_handler_func timer_interrupt;
-static bool too_many_loops(unsigned loops);
-static void busy_wait(int64_t loops);
 static void real_time_sleep(int64_t num, int32_t denom);
-static void wake_up(int64_t cur_tick);
-static bool compare_tick(const struct list_elem *a, const struct list_elem *b, void *aux);
 
-typedef struct block_threads_struct
-{
-	struct thread *block_threads;
-	int64_t wakeup_tick;
-	struct list_elem elem;
-} block_thread;
-
-struct list block_thread_list;
-int64_t closet_tick = NULL; // 다음에 깨워야할 틱
+/* 계층형 타이머 휠
+ * 단계마다 WHEEL_SIZE개의 슬롯이 있고, 단계 L의 슬롯 하나는 WHEEL_SIZE^L 틱을 맡습니다.
+ * 남은 시간이 WHEEL_SIZE 틱보다 짧은 타이머는 단계 0의 만료 틱 슬롯에, 더 먼 타이머는 윗단계에 겁니다.
+ * 단계 0이 한 바퀴 돌 때마다 윗단계의 다음 슬롯을 풀어 아랫단계로 다시 겁니다(cascade).
+ * 그래서 걸기와 풀기는 O(1), 틱마다 하는 일은 만료된 타이머 수에 비례합니다.
+ * 가장 윗단계보다 먼 타이머는 가장 먼 슬롯에 두었다가 내려올 때 다시 자리를 찾습니다.
+ * 인터럽트를 끈 상태에서만 건드립니다. */
+#define WHEEL_BITS 6
+#define WHEEL_SIZE (1 << WHEEL_BITS)
+#define WHEEL_MASK (WHEEL_SIZE - 1)
+#define WHEEL_LEVELS 4
+static struct list wheel[WHEEL_LEVELS][WHEEL_SIZE];
+static int64_t wheel_tick; /* 휠이 처리를 마친 마지막 틱 */
+
+static void wheel_insert(struct timer *t, int64_t base);
+static bool wheel_run(int64_t now);
+static void wake_thread(void *t_);
+static int64_t wheel_idle_ticks(int64_t limit);
+static void pit_periodic(void);
+static void tickless_catch_up(int64_t skipped);
 
 /* Sets up the 8254 Programmable Interval Timer (PIT) to
    interrupt PIT_FREQ times per second, and registers the
@@ -48,40 +76,44 @@ void timer_init(void)
 {
 	/* 8254 input frequency divided by TIMER_FREQ, rounded to
 	   nearest. */
-	uint16_t count = (1193180 + TIMER_FREQ / 2) / TIMER_FREQ;
+	tick_count = (PIT_HZ + TIMER_FREQ / 2) / TIMER_FREQ;
+	pit_periodic();
 
-	outb(0x43, 0x34); /* CW: counter 0, LSB then MSB, mode 2, binary. */
-	outb(0x40, count & 0xff);
-	outb(0x40, count >> 8);
-	list_init(&block_thread_list); // 블락 스레드 리스트 초기화
+	for (int level = 0; level < WHEEL_LEVELS; level++)
+		for (int slot = 0; slot < WHEEL_SIZE; slot++)
+			list_init(&wheel[level][slot]);
+	wheel_tick = 0;
 
 	intr_register_ext(0x20, timer_interrupt, "8254 Timer");
 }
 
-/* Calibrates loops_per_tick, used to implement brief delays. */
+/* TSC가 1초에 몇 클럭 흐르는지 PIT에 맞춰 잽니다. timer_nanos()와 짧은 지연에 씁니다.
+   틱 경계에서 시작해 TSC_CALIBRATE_TICKS 틱 동안 늘어난 TSC를 재고,
+   틱 하나의 실제 길이는 8254 입력 주파수와 tick_count로 정확히 계산합니다. */
 void timer_calibrate(void)
 {
-	unsigned high_bit, test_bit;
-
 	ASSERT(intr_get_level() == INTR_ON);
 	printf("Calibrating timer...  ");
 
-	/* Approximate loops_per_tick as the largest power-of-two
-	   still less than one timer tick. */
-	loops_per_tick = 1u << 10;
-	while (!too_many_loops(loops_per_tick << 1))
-	{
-		loops_per_tick <<= 1;
-		ASSERT(loops_per_tick != 0);
-	}
+	/* Wait for a timer tick. */
+	int64_t start = ticks;
+	while (ticks == start)
+		barrier();
 
-	/* Refine the next 8 bits of loops_per_tick. */
-	high_bit = loops_per_tick;
-	for (test_bit = high_bit >> 1; test_bit != high_bit >> 10; test_bit >>= 1)
-		if (!too_many_loops(high_bit | test_bit))
-			loops_per_tick |= test_bit;
+	start = ticks;
+	uint64_t tsc_start = rdtsc();
+	while (ticks - start < TSC_CALIBRATE_TICKS)
+		barrier();
+	uint64_t cycles = rdtsc() - tsc_start;
+
+	enum intr_level old_level = intr_disable();
+	tsc_base = rdtsc();
+	nanos_base = ticks * NS_PER_TICK;
+	tsc_hz = cycles * PIT_HZ / ((uint64_t)TSC_CALIBRATE_TICKS * tick_count);
+	intr_set_level(old_level);
+	ASSERT(tsc_hz != 0);
 
-	printf("%'" PRIu64 " loops/s.\n", (uint64_t)loops_per_tick * TIMER_FREQ);
+	printf("%'" PRIu64 " TSC cycles/s.\n", tsc_hz);
 }
 
 /* Returns the number of timer ticks since the OS booted. */
@@ -103,36 +135,133 @@ timer_elapsed(int64_t then)
 	return timer_ticks() - then;
 }
 
+/* 부팅 뒤 흐른 시간을 나노초로 반환합니다. 단조 증가하고, 보정 뒤에는 틱보다 훨씬 잘게 움직입니다. */
+int64_t
+timer_nanos(void)
+{
+	if (tsc_hz == 0)
+		return timer_ticks() * NS_PER_TICK;
+
+	/* 곱셈이 넘치지 않도록 초 단위와 나머지를 나누어 환산합니다. */
+	uint64_t delta = rdtsc() - tsc_base;
+	return nanos_base + (int64_t)(delta / tsc_hz * NS_PER_SEC + delta % tsc_hz * NS_PER_SEC / tsc_hz);
+}
+
 /* Suspends execution for approximately TICKS timer ticks. */
+/* 스레드에 들어 있는 sleep_timer를 휠에 걸고 잠듭니다. 할당이 없으므로 실패하지 않습니다. */
 void timer_sleep(int64_t ticks)
 {
-
 	ASSERT(intr_get_level() == INTR_ON);
 
+	if (ticks <= 0)
+		return;
+
 	struct thread *cur = thread_current(); // 현재 쓰레드 가져오기
-	block_thread *target = malloc(sizeof(block_thread));
+	enum intr_level old_level = intr_disable(); // 인터럽트 끄기 -> 레이스 컨디션을 막기 위해 먼저
+	timer_add(&cur->sleep_timer, ticks + timer_ticks(), wake_thread, cur);
+	thread_block();			   // 쓰레드 블락
+	intr_set_level(old_level); // 원래 상태 복원
+}
 
-	target->block_threads = cur;				 // 블락되는 쓰레드
-	target->wakeup_tick = timer_ticks() + ticks; // 깨울 틱 저장
-	dprintf("깨울 틱 : %d\n", target->wakeup_tick);
+/* timer_sleep()의 타이머 콜백: 잠든 스레드를 깨웁니다. */
+static void wake_thread(void *t_)
+{
+	thread_unblock(t_);
+}
 
-	enum intr_level old_level = intr_disable(); // 인터럽트 끄기 -> 레이스 컨디션을 막기 위해 먼저
-	if (closet_tick == NULL || closet_tick > target->wakeup_tick)
+/* T를 DEADLINE 틱에 FUNC(AUX)를 부르도록 휠에 겁니다. 이미 걸려 있으면 옮겨 겁니다.
+   이미 지난 틱이면 다음 틱에 부릅니다. FUNC는 타이머 인터럽트 안에서 불리므로 잠들면 안 됩니다. */
+void timer_add(struct timer *t, int64_t deadline, timer_func *func, void *aux)
+{
+	enum intr_level old_level = intr_disable();
+
+	if (t->armed)
+		list_remove(&t->elem);
+	t->deadline = deadline;
+	t->func = func;
+	t->aux = aux;
+	t->armed = true;
+	wheel_insert(t, wheel_tick + 1);
+	intr_set_level(old_level);
+}
+
+/* 걸려 있는 T를 풉니다. 아직 만료되지 않아 풀었으면 true를 반환합니다. */
+bool timer_cancel(struct timer *t)
+{
+	enum intr_level old_level = intr_disable();
+	bool armed = t->armed;
+
+	if (armed)
 	{
-		closet_tick = target->wakeup_tick;
+		list_remove(&t->elem);
+		t->armed = false;
 	}
+	intr_set_level(old_level);
+	return armed;
+}
 
-	list_insert_ordered(&block_thread_list, &target->elem, compare_tick, NULL);
-	thread_block();			   // 쓰레드 블락
-	intr_set_level(old_level); // 원래 상태 복원
+/* 남은 시간에 맞는 단계와 슬롯에 T를 넣습니다. BASE보다 이른 만료 틱은 BASE로 당겨 씁니다.
+   cascade는 지금 처리 중인 틱(wheel_tick)의 슬롯에도 넣을 수 있고, 그 밖에서는 다음 틱부터입니다. */
+static void wheel_insert(struct timer *t, int64_t base)
+{
+	int64_t expires = t->deadline;
+
+	if (expires < base)
+		expires = base;
+
+	int64_t delta = expires - wheel_tick;
+	int level = 0;
+	while (level < WHEEL_LEVELS - 1 && delta >= (int64_t)1 << (WHEEL_BITS * (level + 1)))
+		level++;
+
+	/* 가장 윗단계보다 먼 타이머는 가장 먼 슬롯에 둡니다. */
+	int64_t span = (int64_t)1 << (WHEEL_BITS * WHEEL_LEVELS);
+	if (delta >= span)
+		expires = wheel_tick + span - 1;
+
+	int slot = (expires >> (WHEEL_BITS * level)) & WHEEL_MASK;
+	list_push_back(&wheel[level][slot], &t->elem);
 }
 
-static bool compare_tick(const struct list_elem *a, const struct list_elem *b, void *aux)
+/* 단계 LEVEL의 SLOT에 있는 타이머들을 떼어 내 남은 시간에 맞게 다시 겁니다. */
+static void wheel_cascade(int level, int slot)
 {
-	block_thread *t1 = list_entry(a, block_thread, elem);
-	block_thread *t2 = list_entry(b, block_thread, elem);
+	struct list pending;
 
-	return t1->wakeup_tick < t2->wakeup_tick;
+	list_init(&pending);
+	while (!list_empty(&wheel[level][slot]))
+		list_push_back(&pending, list_pop_front(&wheel[level][slot]));
+	while (!list_empty(&pending))
+		wheel_insert(list_entry(list_pop_front(&pending), struct timer, elem), wheel_tick);
+}
+
+/* 휠을 NOW 틱까지 돌리며 만료된 타이머의 콜백을 부릅니다. 하나라도 불렀으면 true를 반환합니다. */
+static bool wheel_run(int64_t now)
+{
+	bool fired = false;
+
+	while (wheel_tick < now)
+	{
+		wheel_tick++;
+
+		/* 아랫단계가 한 바퀴 돌았으면 윗단계의 다음 슬롯을 내려 보냅니다. */
+		for (int level = 1; level < WHEEL_LEVELS; level++)
+		{
+			if ((wheel_tick & (((int64_t)1 << (WHEEL_BITS * level)) - 1)) != 0)
+				break;
+			wheel_cascade(level, (wheel_tick >> (WHEEL_BITS * level)) & WHEEL_MASK);
+		}
+
+		struct list *slot = &wheel[0][wheel_tick & WHEEL_MASK];
+		while (!list_empty(slot))
+		{
+			struct timer *t = list_entry(list_pop_front(slot), struct timer, elem);
+			t->armed = false;
+			t->func(t->aux);
+			fired = true;
+		}
+	}
+	return fired;
 }
 
 /* Suspends execution for approximately MS milliseconds. */
@@ -153,55 +282,142 @@ void timer_nsleep(int64_t ns)
 	real_time_sleep(ns, 1000 * 1000 * 1000);
 }
 
-/* Prints timer statistics. */
-void timer_print_stats(void)
+/* PIT 카운터 0을 틱마다 인터럽트를 거는 주기 모드로 설정합니다. */
+static void pit_periodic(void)
 {
-	printf("Timer: %" PRId64 " ticks\n", timer_ticks());
+	outb(0x43, 0x34); /* CW: counter 0, LSB then MSB, mode 2, binary. */
+	outb(0x40, tick_count & 0xff);
+	outb(0x40, tick_count >> 8);
 }
 
-// 여기서 틱을 보고 같으면 쓰레드 꺠우기
-static void
-timer_interrupt(struct intr_frame *args UNUSED)
+/* PIT 카운터 0을 COUNT 뒤에 한 번만 인터럽트를 거는 모드로 설정합니다. */
+static void pit_oneshot(uint16_t count)
 {
-	ticks++;
-	thread_tick();
-	int64_t cur_tick = timer_ticks();
-	// printf("현재 틱 : %d\n", cur_tick);
-	// dprintf("실행 쓰레드 %s, 우선순위 : %d\n", thread_name(), thread_get_priority());
-	if (closet_tick != NULL && cur_tick >= closet_tick) // 현재 틱이 블락된 쓰레드 로컬 틱이랑 같거나 크면
+	outb(0x43, 0x30); /* CW: counter 0, LSB then MSB, mode 0, binary. */
+	outb(0x40, count & 0xff);
+	outb(0x40, count >> 8);
+}
+
+/* PIT 카운터 0의 상태와 남은 카운트를 한 번에 래치해 남은 카운트를 *COUNT에 담습니다.
+   one-shot이 이미 끝났으면(OUT 핀이 올라갔으면) true를 반환합니다.
+   따로 읽으면 그 사이에 끝난 카운터가 0xffff로 돌아가 있을 수 있어 같은 순간의 값을 씁니다. */
+static bool pit_latch(uint16_t *count)
+{
+	outb(0x43, 0xc2); /* Read-back: latch status and count of counter 0. */
+	uint8_t status = inb(0x40);
+	uint8_t lo = inb(0x40);
+	uint8_t hi = inb(0x40);
+	*count = lo | (hi << 8);
+	return (status & 0x80) != 0;
+}
+
+/* 지금부터 LIMIT 틱 안에서 처리할 일이 있는 첫 틱까지의 거리를 반환합니다.
+   만료될 타이머가 든 단계 0 슬롯이나 cascade가 일어나는 틱에서 멈춥니다.
+   단계 0에는 WHEEL_SIZE 틱 안에 만료되는 타이머만 있으므로 슬롯이 비어 있지 않으면 그 틱에 할 일이 있습니다. */
+static int64_t wheel_idle_ticks(int64_t limit)
+{
+	for (int64_t d = 1; d < limit; d++)
 	{
-		// printf("wakeup\n");
-		wake_up(cur_tick);
+		int64_t tick = wheel_tick + d;
+		if ((tick & WHEEL_MASK) == 0 || !list_empty(&wheel[0][tick & WHEEL_MASK]))
+			return d;
 	}
+	return limit;
 }
 
-static void wake_up(int64_t cur_tick)
+/* idle 스레드가 hlt 직전에 부릅니다. 다음에 할 일이 있는 틱까지 틱 인터럽트를 멈추고
+   PIT를 그 틱에 한 번만 울리도록 겁니다. 8254 카운터는 16비트라 한 번에 건너뛸 수 있는 틱 수가 제한됩니다. */
+void timer_idle_enter(void)
 {
-	struct list_elem *e;
-	for (e = list_begin(&block_thread_list); e != list_end(&block_thread_list);)
-	{
-		block_thread *entry = list_entry(e, block_thread, elem);
-		struct list_elem *next = list_next(e);
-		if (entry->wakeup_tick <= cur_tick)
-		{
-			dprintf("wakeup\n");
-			list_remove(e);
-			thread_unblock(entry->block_threads);
-		}
-		else
-			break;
+	ASSERT(intr_get_level() == INTR_OFF);
+
+	/* 이미 걸려 있으면(다른 인터럽트로 잠깐 깼을 때) 그대로 둡니다. */
+	if (oneshot_ticks != 0)
+		return;
+	ASSERT(wheel_tick == ticks);
+
+	int64_t limit = UINT16_MAX / tick_count;
+	/* MLFQS는 매 초 경계 틱에 load_avg를 갱신하므로 그 틱은 건너뛰지 않습니다. */
+	if (thread_mlfqs && TIMER_FREQ - ticks % TIMER_FREQ < limit)
+		limit = TIMER_FREQ - ticks % TIMER_FREQ;
+
+	int64_t n = wheel_idle_ticks(limit);
+	if (n < 2)
+		return;
+	oneshot_ticks = n;
+	pit_oneshot(n * tick_count);
+}
 
-		e = next;
+/* one-shot이 걸려 있으면 지금까지 지난 틱을 따라잡고 주기 모드로 되돌립니다.
+   실행할 스레드가 생기면(thread_unblock) 부릅니다.
+   틱의 위상을 지키려고 지금 틱의 남은 카운트만큼 one-shot을 한 번 더 걸고, 그 인터럽트에서 주기 모드로 돌아갑니다. */
+void timer_idle_exit(void)
+{
+	ASSERT(intr_get_level() == INTR_OFF);
+
+	/* 남은 부분만 걸어 둔 상태라면 따라잡을 틱이 없습니다. */
+	if (oneshot_ticks < 2)
+		return;
+
+	uint16_t remaining;
+	if (pit_latch(&remaining))
+	{
+		/* 이미 끝났다면 마지막 틱은 곧 들어올 타이머 인터럽트가 셉니다. */
+		tickless_catch_up(oneshot_ticks - 1);
+		oneshot_ticks = 0;
+		pit_periodic();
+		return;
 	}
 
-	if (list_empty(&block_thread_list)) // 리스트가 비어있을 경우
-		closet_tick = NULL;				// 깨워야할 틱이 없으니까 -1로
-	else								// 있을 경우
+	/* one-shot은 틱 경계에서 끝나므로 REMAINING 안에 남은 틱 경계 수를 빼면 이미 지난 틱 수입니다. */
+	if (remaining == 0)
+		remaining = 1;
+	int64_t future = (remaining + tick_count - 1) / tick_count;
+	int64_t skipped = oneshot_ticks - future;
+	if (skipped < 0)
+		skipped = 0;
+	if (skipped > oneshot_ticks - 1)
+		skipped = oneshot_ticks - 1;
+
+	tickless_catch_up(skipped);
+	oneshot_ticks = 1;
+	pit_oneshot((remaining - 1) % tick_count + 1);
+}
+
+/* 인터럽트 없이 지나간 SKIPPED 틱을 반영합니다. 고른 구간 안에는 만료될 타이머도 cascade도 없고,
+   idle만 돌았으므로 idle 시간으로만 셉니다. */
+static void tickless_catch_up(int64_t skipped)
+{
+	ticks += skipped;
+	thread_idle_ticks(skipped);
+	wheel_run(ticks);
+}
+
+/* Prints timer statistics. */
+void timer_print_stats(void)
+{
+	printf("Timer: %" PRId64 " ticks, %" PRId64 " ms\n", timer_ticks(), timer_nanos() / 1000000);
+}
+
+// 여기서 틱을 보고 만료된 타이머 처리 (잠든 쓰레드 꺠우기 등)
+static void
+timer_interrupt(struct intr_frame *args UNUSED)
+{
+	// one-shot이 울렸으면 건너뛴 틱을 따라잡고 주기 모드로 복귀
+	if (oneshot_ticks != 0)
 	{
-		e = list_front(&block_thread_list); // 맨 앞의 엔트리를 가져와서 전역 틱에 저장
-		block_thread *entry = list_entry(e, block_thread, elem);
-		closet_tick = entry->wakeup_tick;
+		int64_t skipped = oneshot_ticks - 1;
+
+		oneshot_ticks = 0;
+		tickless_catch_up(skipped);
+		pit_periodic();
 	}
+
+	ticks++;
+	thread_tick();
+	// 깨어난 쓰레드가 우선순위가 더 높다면 인터럽트에서 돌아갈 때 양보
+	if (wheel_run(ticks))
+		compare_cur_next_priority();
 }
 
 /* mlfqs에서 틱마다 발생하는 상황에 대응하기 위한 함수입니다 */
@@ -213,75 +429,31 @@ void mlfqs_on_tick()
 	{
 		update_load_avg();
 		update_recent_cpu_all();
-	} // 모든 스레드 recent_cpu 계산
+	} // recent_cpu 감쇠 계수를 남기고 ready 스레드 우선순위 갱신
 
+	/* 다른 스레드의 recent_cpu와 nice는 4틱 사이에 바뀌지 않으므로 실행 중인 스레드만 다시 계산합니다. */
 	if (timer_ticks() % 4 == 0)
 	{
-		// update_priority(thread_current());
-		update_all_priority();
+		update_priority(thread_current());
 		compare_cur_next_priority();
 	}
 }
 
-/* Returns true if LOOPS iterations waits for more than one timer
-   tick, otherwise false. */
-static bool
-too_many_loops(unsigned loops)
-{
-	/* Wait for a timer tick. */
-	int64_t start = ticks;
-	while (ticks == start)
-		barrier();
-
-	/* Run LOOPS loops. */
-	start = ticks;
-	busy_wait(loops);
-
-	/* If the tick count changed, we iterated too long. */
-	barrier();
-	return start != ticks;
-}
-
-/* Iterates through a simple loop LOOPS times, for implementing
-   brief delays.
-
-   Marked NO_INLINE because code alignment can significantly
-   affect timings, so that if this function was inlined
-   differently in different places the results would be difficult
-   to predict. */
-static void NO_INLINE
-busy_wait(int64_t loops)
-{
-	while (loops-- > 0)
-		barrier();
-}
-
 /* Sleep for approximately NUM/DENOM seconds. */
+/* 끝나는 시각을 나노초 시계로 정해 두고, 틱 하나 이상 남아 있는 동안은 타이머 휠에 걸고 잠듭니다.
+   깨어날 때마다 남은 시간을 다시 재므로 틱 경계와 어긋나도 덜 자거나 더 자지 않고,
+   틱 하나보다 짧게 남은 나머지만 TSC를 보며 기다립니다. */
 static void
 real_time_sleep(int64_t num, int32_t denom)
 {
-	/* Convert NUM/DENOM seconds into timer ticks, rounding down.
+	ASSERT(intr_get_level() == INTR_ON);
+	ASSERT(NS_PER_SEC % denom == 0);
 
-	   (NUM / DENOM) s
-	   ---------------------- = NUM * TIMER_FREQ / DENOM ticks.
-	   1 s / TIMER_FREQ ticks
-	   */
-	int64_t ticks = num * TIMER_FREQ / denom;
+	int64_t end = timer_nanos() + num * (NS_PER_SEC / denom);
+	int64_t left;
 
-	ASSERT(intr_get_level() == INTR_ON);
-	if (ticks > 0)
-	{
-		/* We're waiting for at least one full timer tick.  Use
-		   timer_sleep() because it will yield the CPU to other
-		   processes. */
-		timer_sleep(ticks);
-	}
-	else
-	{
-		/* Otherwise, use a busy-wait loop for more accurate
-		   sub-tick timing.  We scale the numerator and denominator
-		   down by 1000 to avoid the possibility of overflow. */
-		ASSERT(denom % 1000 == 0);
-		busy_wait(loops_per_tick * num / 1000 * TIMER_FREQ / (denom / 1000));
-	}
+	while ((left = end - timer_nanos()) >= NS_PER_TICK)
+		timer_sleep(left / NS_PER_TICK);
+	while (timer_nanos() < end)
+		asm volatile("pause");
 }
@@ -1,7 +1,9 @@
 #ifndef DEVICES_TIMER_H
 #define DEVICES_TIMER_H
 
+#include <list.h>
 #include <round.h>
+#include <stdbool.h>
 #include <stdint.h>
 
 /* Number of timer interrupts per second. */
@@ -12,6 +14,7 @@ void timer_calibrate (void);
 
 int64_t timer_ticks (void);
 int64_t timer_elapsed (int64_t);
+int64_t timer_nanos (void);
 
 void timer_sleep (int64_t ticks);
 void timer_msleep (int64_t milliseconds);
@@ -20,4 +23,24 @@ void timer_nsleep (int64_t nanoseconds);
 
 void timer_print_stats (void);
 
+void timer_idle_enter (void);
+void timer_idle_exit (void);
+
+/* 지정한 틱에 타이머 인터럽트 안에서 불리는 콜백입니다. */
+typedef void timer_func (void *aux);
+
+/* 타이머 휠에 거는 타이머. 호출자가 구조체를 가지고 있으므로 걸고 풀 때 할당이 없습니다.
+   걸려 있는 동안에는 구조체가 살아 있어야 합니다. */
+struct timer
+  {
+    struct list_elem elem;      /* 타이머 휠 슬롯의 원소 */
+    int64_t deadline;           /* 만료 틱 */
+    timer_func *func;           /* 만료 때 부를 함수 */
+    void *aux;                  /* FUNC에 넘길 인자 */
+    bool armed;                 /* 휠에 걸려 있는지 */
+  };
+
+void timer_add (struct timer *, int64_t deadline, timer_func *, void *aux);
+bool timer_cancel (struct timer *);
+
 #endif /* devices/timer.h */
@@ -53,6 +53,41 @@ static __inline uint64_t rcr3(void) {
 	return val;
 }
 
+__attribute__((always_inline))
+static __inline uint64_t rcr4(void) {
+	uint64_t val;
+	__asm __volatile("movq %%cr4,%0" : "=r" (val));
+	return val;
+}
+
+__attribute__((always_inline))
+static __inline void lcr4(uint64_t val) {
+	__asm __volatile("movq %0, %%cr4" : : "r" (val));
+}
+
+/* CPUID 명령어로 LEAF(EAX), SUBLEAF(ECX)의 정보를 읽어 REGS[0..3]에 EAX, EBX, ECX, EDX 순으로 담음. */
+__attribute__((always_inline))
+static __inline void cpuid(uint32_t leaf, uint32_t subleaf, uint32_t regs[4]) {
+	__asm __volatile("cpuid"
+			: "=a" (regs[0]), "=b" (regs[1]), "=c" (regs[2]), "=d" (regs[3])
+			: "a" (leaf), "c" (subleaf));
+}
+
+/* 부팅 뒤 흐른 CPU 클럭 수(TSC)를 읽음. */
+__attribute__((always_inline))
+static __inline uint64_t rdtsc(void) {
+	uint32_t lo, hi;
+	__asm __volatile("rdtsc" : "=a" (lo), "=d" (hi));
+	return ((uint64_t) hi << 32) | lo;
+}
+
+/* INVPCID 명령어. TYPE 0은 (PCID, ADDR) 한 항목, 1은 PCID의 모든 항목을 무효화함. */
+__attribute__((always_inline))
+static __inline void invpcid(uint64_t type, uint64_t pcid, uint64_t addr) {
+	struct { uint64_t pcid, addr; } desc = { pcid, addr };
+	__asm __volatile("invpcid %0, %1" : : "m" (desc), "r" (type) : "memory");
+}
+
 __attribute__((always_inline))
 static __inline uint64_t rrax(void) {
 	uint64_t val;
@@ -36,6 +36,13 @@ enum {
 
 	SYS_MOUNT,
 	SYS_UMOUNT,
+
+	/* Extra for Project 3 */
+	SYS_MADVISE,                /* Give advice about use of a mapping. */
+	SYS_MSYNC,                  /* Write back a mapping to its file. */
+	SYS_BRK,                    /* Move the end of the heap. */
+	SYS_MEMNOTIFY,              /* Wait for low memory. */
+	SYS_CLOCKNANOS,             /* Read the nanosecond clock. */
 };
 
 #endif /* lib/syscall-nr.h */
@@ -0,0 +1,12 @@
+#ifndef __LIB_USER_MALLOC_H
+#define __LIB_USER_MALLOC_H
+
+#include <stddef.h>
+
+/* User-space heap allocator built on sbrk(). */
+void *malloc (size_t size);
+void *calloc (size_t cnt, size_t size);
+void *realloc (void *old, size_t new_size);
+void free (void *p);
+
+#endif /* lib/user/malloc.h */
@@ -4,6 +4,7 @@
 #include <stdbool.h>
 #include <debug.h>
 #include <stddef.h>
+#include <stdint.h>
 
 /* Process identifier. */
 typedef int pid_t;
@@ -12,6 +13,15 @@ typedef int pid_t;
 /* Map region identifier. */
 typedef int off_t;
 #define MAP_FAILED ((void *) NULL)
+#define MAP_ANON (-1)           /* mmap() fd for a zero-filled anonymous mapping. */
+#define MAP_POPULATE 0x2        /* OR into mmap()'s WRITABLE to map every page up front. */
+
+/* madvise() advice values. */
+#define MADV_NORMAL 0           /* No special treatment. */
+#define MADV_RANDOM 1           /* Expect random access; no readahead. */
+#define MADV_SEQUENTIAL 2       /* Expect sequential access; read ahead, drop behind. */
+#define MADV_WILLNEED 3         /* Will need these pages soon; prefetch them. */
+#define MADV_DONTNEED 4         /* Done with these pages; drop them now. */
 
 /* Maximum characters in a filename written by readdir(). */
 #define READDIR_MAX_LEN 14
@@ -41,6 +51,12 @@ int dup2(int oldfd, int newfd);
 /* Project 3 and optionally project 4. */
 void *mmap (void *addr, size_t length, int writable, int fd, off_t offset);
 void munmap (void *addr);
+int madvise (void *addr, size_t length, int advice);
+int msync (void *addr, size_t length);
+int brk (void *addr);
+void *sbrk (intptr_t increment);
+int mem_notify (void);
+int64_t clock_nanos (void);
 
 /* Project 4 only. */
 bool chdir (const char *dir);
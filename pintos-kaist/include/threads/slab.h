@@ -0,0 +1,16 @@
+#ifndef THREADS_SLAB_H
+#define THREADS_SLAB_H
+
+#include <stddef.h>
+
+/* 같은 크기의 커널 객체를 위한 캐시 (kmem_cache).
+   자세한 내용은 threads/slab.c를 참고하세요. */
+struct kmem_cache;
+
+struct kmem_cache *kmem_cache_create (const char *name, size_t size,
+		void (*ctor) (void *));
+void *kmem_cache_alloc (struct kmem_cache *);
+void kmem_cache_free (struct kmem_cache *, void *);
+void kmem_cache_print_stats (void);
+
+#endif /* threads/slab.h */
@@ -7,6 +7,7 @@
 #include "threads/interrupt.h"
 #include "threads/fixed-point.h"
 #include "threads/synch.h"
+#include "devices/timer.h"
 
 #ifdef VM
 #include "vm/vm.h"
@@ -111,6 +112,7 @@ struct thread
 
 	int nice;			// 양보하려는 정도?
 	fixed_t recent_cpu; // CPU를 얼마나 점유했나?
+	int64_t rc_sec;		// recent_cpu에 감쇠를 적용한 마지막 초 (MLFQS)
 	struct list_elem all_elem;
 	// TODO : 동적할당으로 해야할지도
 	struct file **fd_table; // 파일 디스크럽터 테이블
@@ -118,6 +120,7 @@ struct thread
 	struct semaphore fork_sema; // fork 동기화를 위한 세마포어
 	struct semaphore wait_sema; // wait를 위한 세마포어
 	struct semaphore free_sema; // 받았음을 전달하는 세마포어
+	struct timer sleep_timer;	// timer_sleep()이 거는 타이머
 
 	struct list children_list; /* 나의 자식 프로세스 리스트 */
 	struct list_elem child_elem;
@@ -130,6 +133,7 @@ struct thread
 #ifdef USERPROG
 	/* Owned by userprog/process.c. */
 	uint64_t *pml4; /* Page map level 4 */
+	bool killed;	/* 다른 스레드(OOM 킬러)가 종료를 요청함. 유저 모드로 돌아가기 전에 exit(-1) */
 
 #endif
 #ifdef VM
@@ -152,6 +156,7 @@ void thread_init(void);
 void thread_start(void);
 
 void thread_tick(void);
+void thread_idle_ticks(int64_t);
 void thread_print_stats(void);
 
 typedef void thread_func(void *aux);
@@ -167,8 +172,13 @@ const char *thread_name(void);
 void thread_exit(void) NO_RETURN;
 void thread_yield(void);
 
+/* Performs some operation on thread t, given auxiliary data AUX. */
+typedef void thread_action_func(struct thread *t, void *aux);
+void thread_foreach(thread_action_func *, void *);
+
 int thread_get_priority(void);
 void thread_set_priority(int);
+void thread_change_priority(struct thread *, int);
 void compare_cur_next_priority(void);
 
 int thread_get_nice(void);
@@ -177,7 +187,6 @@ int thread_get_recent_cpu(void);
 int thread_get_load_avg(void);
 
 void update_priority(struct thread *);
-void update_all_priority(void);
 void update_recent_cpu(void);
 void update_recent_cpu_all(void);
 void update_load_avg(void);
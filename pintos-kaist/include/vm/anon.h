@@ -10,9 +10,15 @@ struct anon_page
 {
     /* 음수이면 스왑 아웃 상태가 아님 */
     int swap_idx;
+    /* 실행 파일에서 읽어 온 뒤 한 번도 dirty가 된 적 없으면 원본 위치, 아니면 NULL.
+     * 이런 페이지는 교체할 때 스왑에 쓰지 않고 버렸다가 다음 fault에 파일에서 다시 읽습니다. */
+    struct file_info *backing;
 };
 
 void vm_anon_init(void);
 bool anon_initializer(struct page *page, enum vm_type type, void *kva);
+void anon_swap_share(struct page *dst, struct page *src);
+void anon_drop_backing(struct page *page);
+void *anon_swap_slot_va(size_t slot);
 
 #endif
@@ -1,24 +1,57 @@
 #ifndef VM_FILE_H
 #define VM_FILE_H
+#include <list.h>
 #include "filesys/file.h"
 #include "vm/vm.h"
 
 struct page;
 enum vm_type;
 
+/* madvise()로 VMA에 남겨 둔 접근 패턴 */
+enum vma_advice
+{
+	VMA_NORMAL,		/* 폴트 때 FAULT_AROUND 만큼 이웃을 채웁니다. */
+	VMA_RANDOM,		/* 폴트 난 페이지만 읽습니다. */
+	VMA_SEQUENTIAL, /* 더 멀리 미리 읽고, 지나간 페이지는 내려놓습니다. */
+};
 
-struct file_page
+
+/* mmap으로 만든 가상 주소 구간 하나 (Virtual Memory Area).
+ * 매핑 전체가 파일 핸들과 백업 정보를 공유하고, 페이지 구조체는 폴트가 난 페이지만 만듭니다. */
+struct vma
 {
-	/* dirty bit가 명시적으로 필요한가??
-	어차피 PTE의 dirty bit가 있는데  */
+	void *start;		   /* 매핑 시작 주소 (페이지 정렬) */
+	void *end;			   /* 매핑 끝 주소 (페이지 정렬, 미포함) */
+	struct file *file;	   /* 이 매핑 전용으로 reopen한 파일 */
+	off_t ofs;			   /* start에 대응하는 파일 오프셋 */
+	size_t length;		   /* 파일에서 읽어 오는 바이트 수 (이후는 0) */
+	bool writable;
+	enum vma_advice advice;
+	struct list_elem elem; /* supplemental_page_table.vmas (시작 주소 순) */
+};
 
-	// file_backup 정보를 필드로 두어도 될듯함
-	void *aux;
+struct file_page
+{
+	/* 파일 오프셋과 읽을 길이는 VMA와 가상 주소로부터 계산합니다. */
+	struct vma *vma;
 };
 
 void vm_file_init(void);
 bool file_backed_initializer(struct page *page, enum vm_type type, void *kva);
 void *do_mmap(void *addr, size_t length, int writable,
-			  struct file *file, off_t offset, size_t mmap_length);
+			  struct file *file, off_t offset);
 void do_munmap(void *va);
+off_t file_page_offset(struct page *page);
+uint32_t file_page_read_bytes(struct page *page);
+
+struct supplemental_page_table;
+struct vma *vma_find(struct supplemental_page_table *spt, const void *addr);
+bool vma_overlaps(struct supplemental_page_table *spt, const void *start, const void *end);
+bool vma_copy(struct supplemental_page_table *dst, struct supplemental_page_table *src);
+void vma_kill(struct supplemental_page_table *spt);
+void vma_drop_range(struct supplemental_page_table *spt, void *start, void *end);
+bool vma_extend(struct supplemental_page_table *spt, void *start, void *end, void *new_end);
+void vma_truncate(struct supplemental_page_table *spt, void *start, void *end);
+int do_madvise(void *addr, size_t length, int advice);
+int do_msync(void *addr, size_t length);
 #endif
@@ -2,6 +2,8 @@
 #define VM_VM_H
 #include <stdbool.h>
 #include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/slab.h"
 #include "lib/kernel/hash.h"
 
 enum vm_type
@@ -47,9 +49,6 @@ struct file_info
 	uint32_t read_bytes;
 	uint32_t zero_bytes;
 	bool writable; //필요할까?
-
-	size_t mmap_length;
-
 };
 
 
@@ -65,6 +64,8 @@ struct page
 
 	/* 구현 필드 */
 	bool writable;
+	struct thread *owner; /* 이 페이지를 매핑한 프로세스 (pml4 조회용) */
+	struct list_elem rmap_elem; /* frame->rmap의 원소 */
 
 	//spt용 hash_elem
 	struct hash_elem hash_elem;
@@ -87,10 +88,33 @@ struct page
 struct frame
 {
 	void *kva;
-	struct page *page;
+	struct page *page; /* 대표 매핑 (rmap의 첫 번째 페이지) */
 	struct list_elem frame_elem;
 
-	int r_cnt; //현재 프레임을 참조하는 페이지 수
+	/* 역매핑: 이 프레임을 매핑한 모든 페이지.
+	 * 각 페이지의 (owner->pml4, va)가 곧 이 프레임을 가리키는 PTE입니다. */
+	struct list rmap;
+	int r_cnt; //현재 프레임을 참조하는 페이지 수 (rmap의 길이)
+	bool pinned; /* true면 교체 대상에서 제외 (swap_in 진행 중 등) */
+	bool evicting; /* true면 frame_lock 없이 교체 I/O 중. 매핑을 바꾸려면 끝날 때까지 기다립니다 */
+
+	/* 읽기 전용 파일 페이지 공유 테이블(share_table)에 등록된 경우의 키 */
+	bool shared_ro;
+	struct share_key
+	{
+		disk_sector_t sector; /* 파일 inode 섹터 */
+		off_t ofs;			  /* 파일 내 오프셋 */
+		uint32_t read_bytes;  /* 파일에서 읽는 바이트 수 (나머지는 0) */
+	} share_key;
+	struct hash_elem share_elem;
+
+	/* KSM 스캐너가 지난번에 본 내용의 해시와, 병합 후보 테이블(ksm_table)의 원소 */
+	unsigned ksm_checksum;
+	bool ksm_listed;
+	struct hash_elem ksm_elem;
+
+	/* working set 샘플러가 PTE에서 옮겨 온 accessed 비트. clock은 PTE 비트와 함께 봅니다. */
+	bool referenced;
 };
 
 /* 페이지 작업을 위한 함수 테이블입니다.
@@ -117,16 +141,51 @@ struct page_operations
 struct supplemental_page_table
 {
 	struct hash spt_hash;
+	struct list vmas; /* mmap 구간들 (struct vma), 시작 주소 순 */
+	void *heap_start; /* 힙 시작 주소 (실행 파일의 마지막 세그먼트 바로 뒤) */
+	void *heap_brk;	  /* 현재 힙의 끝 (brk), 페이지 정렬되어 있지 않을 수 있음 */
+
+	/* 상주 집합(RSS)과 working set 추정치. 모두 frame_lock으로 보호합니다. */
+	size_t rss;		 /* 이 프로세스가 매핑한 유저 풀 프레임 수 (공유 프레임은 매핑마다 셉니다) */
+	size_t ws_size;	 /* 직전 샘플 구간에 접근한 페이지 수 */
+	size_t ws_cur;	 /* 진행 중인 샘플 구간에서 지금까지 센 페이지 수 */
+	unsigned ws_gen; /* ws_cur를 센 샘플 구간 번호 */
+	size_t swap_cnt; /* 이 프로세스의 익명 페이지가 들고 있는 스왑 슬롯 수 (swap_lock으로 보호) */
 };
 
 struct frame_table
 {
 	struct list frame_list;
+	struct list_elem *clock_hand; /* clock 알고리즘이 다음에 검사할 프레임 */
+	struct list_elem *ksm_hand;	  /* KSM 스캐너가 다음에 검사할 프레임 */
+	struct lock frame_lock;		  /* frame_list와 clock_hand 보호 */
 };
 
 
 #include "threads/thread.h"
 extern struct frame_table *frame_table;
+
+/* page, frame, file_info 구조체용 슬랩 캐시 (vm_init에서 생성) */
+extern struct kmem_cache *page_cachep;
+extern struct kmem_cache *frame_cachep;
+extern struct kmem_cache *file_info_cachep;
+
+/* pageout 데몬 워터마크 (유저 풀의 빈 페이지 수, 0이면 vm_init에서 기본값 계산) */
+extern size_t vm_low_watermark;
+extern size_t vm_high_watermark;
+
+/* KSM 스캐너가 한 번 깨어날 때 검사하는 프레임 수 (0이면 스캐너를 띄우지 않음) */
+extern size_t vm_ksm_scan_pages;
+
+/* 0 페이지로 채워질 2MB 정렬 구간을 큰 페이지로 매핑할지 여부 (-lp) */
+extern bool vm_large_pages;
+
+/* 프로세스 하나가 가질 수 있는 상주 프레임 수 (-rss, 0이면 제한 없음) */
+extern size_t vm_rss_limit;
+
+/* working set 샘플링 주기 (-ws, 타이머 틱 단위, 0이면 샘플러를 띄우지 않음) */
+extern int64_t vm_ws_ticks;
+
 void supplemental_page_table_init(struct supplemental_page_table *spt);
 bool supplemental_page_table_copy(struct supplemental_page_table *dst,
 								  struct supplemental_page_table *src);
@@ -135,6 +194,7 @@ struct page *spt_find_page(struct supplemental_page_table *spt,
 						   void *va);
 bool spt_insert_page(struct supplemental_page_table *spt, struct page *page);
 void spt_remove_page(struct supplemental_page_table *spt, struct page *page);
+bool spt_range_used(struct supplemental_page_table *spt, void *start, void *end);
 
 void vm_init(void);
 void frame_table_init();
@@ -147,6 +207,13 @@ bool vm_alloc_page_with_initializer(enum vm_type type, void *upage,
 									bool writable, vm_initializer *init, void *aux);
 void vm_dealloc_page(struct page *page);
 bool vm_claim_page(void *va);
+void vm_prefetch(void *start, void *end);
+void vm_populate(void *start, void *end);
+void *vm_brk(void *new_brk);
+int vm_mem_notify(void);
+void vm_free_frame(struct frame *frame);
+void vm_frame_unref(struct page *page);
+void vm_ksm_print_stats(void);
 enum vm_type page_get_type(struct page *page);
 
 #endif /* VM_VM_H */
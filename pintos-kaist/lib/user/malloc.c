@@ -0,0 +1,179 @@
+#include <malloc.h>
+#include <debug.h>
+#include <round.h>
+#include <stdint.h>
+#include <string.h>
+#include <syscall.h>
+
+/* 사용자 프로그램용 메모리 할당기.
+
+   작은 요청(MAX_SMALL 바이트 이하)은 16바이트부터 두 배씩 커지는 크기 등급으로 올려서,
+   등급마다 둔 빈 블록 리스트에서 O(1)로 꺼내고 돌려줍니다.
+   리스트가 비면 sbrk()로 힙을 CHUNK_SIZE 만큼 늘려 그 등급의 블록으로 잘라 한꺼번에 채웁니다.
+   큰 요청은 페이지 단위로 sbrk()에서 받아 오며, 해제된 큰 블록은 리스트에 두었다가
+   크기가 맞는 요청에 다시 씁니다. 힙은 줄이지 않습니다.
+
+   Pintos의 사용자 프로세스는 스레드가 하나뿐이므로 등급별 리스트가 곧 스레드 로컬 캐시이고,
+   락이 필요 없습니다. */
+
+#define MIN_SHIFT 4                     /* 가장 작은 등급: 16바이트. */
+#define CLASS_CNT 8                     /* 16 ~ 2048바이트. */
+#define MAX_SMALL ((size_t) 1 << (MIN_SHIFT + CLASS_CNT - 1))
+#define CHUNK_SIZE (16 * 1024)          /* 작은 블록을 채울 때 늘리는 힙 크기. */
+#define PAGE_SIZE 4096
+#define BLOCK_MAGIC 0x9a548eed
+
+/* 모든 블록 앞에 붙는 헤더. 16바이트라서 돌려주는 주소도 16바이트 정렬됩니다. */
+struct header {
+	size_t size;                /* 헤더를 뺀 블록 크기. */
+	unsigned magic;             /* BLOCK_MAGIC, 잘못된 free()를 잡습니다. */
+	unsigned class;             /* 크기 등급, 큰 블록이면 CLASS_CNT. */
+};
+
+/* 빈 블록은 사용자 영역에 다음 빈 블록을 가리키는 포인터를 둡니다. */
+struct free_block {
+	struct free_block *next;
+};
+
+static struct free_block *free_lists[CLASS_CNT];
+static struct free_block *large_free;
+
+/* SIZE 바이트가 들어가는 가장 작은 등급을 반환합니다. */
+static unsigned
+size_class (size_t size) {
+	if (size <= ((size_t) 1 << MIN_SHIFT))
+		return 0;
+	return 64 - __builtin_clzl (size - 1) - MIN_SHIFT;
+}
+
+/* 힙을 늘려 CLASS 등급의 빈 블록 리스트를 채웁니다. */
+static bool
+refill (unsigned class) {
+	size_t size = (size_t) 1 << (MIN_SHIFT + class);
+	size_t stride = sizeof (struct header) + size;
+	uint8_t *chunk = sbrk (CHUNK_SIZE);
+	size_t ofs;
+
+	if (chunk == (void *) -1)
+		return false;
+
+	for (ofs = 0; ofs + stride <= CHUNK_SIZE; ofs += stride) {
+		struct header *h = (struct header *) (chunk + ofs);
+		struct free_block *b = (struct free_block *) (h + 1);
+
+		h->size = size;
+		h->magic = BLOCK_MAGIC;
+		h->class = class;
+		b->next = free_lists[class];
+		free_lists[class] = b;
+	}
+	return true;
+}
+
+/* SIZE 바이트 이상인 큰 블록을 빈 리스트에서 찾고, 없으면 힙을 늘려 만듭니다. */
+static void *
+large_alloc (size_t size) {
+	struct free_block **p;
+	struct header *h;
+	size_t total;
+
+	for (p = &large_free; *p != NULL; p = &(*p)->next) {
+		h = (struct header *) *p - 1;
+		if (h->size >= size) {
+			struct free_block *b = *p;
+			*p = b->next;
+			return b;
+		}
+	}
+
+	if (size > SIZE_MAX / 2)
+		return NULL;
+	total = ROUND_UP (sizeof *h + size, PAGE_SIZE);
+	h = sbrk (total);
+	if (h == (void *) -1)
+		return NULL;
+	h->size = total - sizeof *h;
+	h->magic = BLOCK_MAGIC;
+	h->class = CLASS_CNT;
+	return h + 1;
+}
+
+/* SIZE 바이트 이상의 블록을 할당해서 반환합니다.
+   SIZE가 0이거나 힙을 더 늘릴 수 없으면 널 포인터를 반환합니다. */
+void *
+malloc (size_t size) {
+	struct free_block *b;
+	unsigned class;
+
+	if (size == 0)
+		return NULL;
+	if (size > MAX_SMALL)
+		return large_alloc (size);
+
+	class = size_class (size);
+	if (free_lists[class] == NULL && !refill (class))
+		return NULL;
+	b = free_lists[class];
+	free_lists[class] = b->next;
+	return b;
+}
+
+/* SIZE 바이트짜리 원소 CNT개를 담을 0으로 채운 블록을 할당합니다. */
+void *
+calloc (size_t cnt, size_t size) {
+	void *p;
+
+	if (size != 0 && cnt > SIZE_MAX / size)
+		return NULL;
+	p = malloc (cnt * size);
+	if (p != NULL)
+		memset (p, 0, cnt * size);
+	return p;
+}
+
+/* OLD 블록을 NEW_SIZE 바이트로 바꿉니다. 이미 충분히 크면 그대로 돌려주고,
+   아니면 새 블록에 내용을 옮깁니다. 실패하면 OLD는 그대로 남습니다. */
+void *
+realloc (void *old, size_t new_size) {
+	struct header *h;
+	void *p;
+
+	if (new_size == 0) {
+		free (old);
+		return NULL;
+	}
+	if (old == NULL)
+		return malloc (new_size);
+
+	h = (struct header *) old - 1;
+	ASSERT (h->magic == BLOCK_MAGIC);
+	if (new_size <= h->size)
+		return old;
+
+	p = malloc (new_size);
+	if (p != NULL) {
+		memcpy (p, old, h->size);
+		free (old);
+	}
+	return p;
+}
+
+/* P 블록을 해제합니다. 블록은 자기 등급(또는 큰 블록)의 빈 리스트로 돌아갑니다. */
+void
+free (void *p) {
+	struct header *h;
+	struct free_block *b = p;
+
+	if (p == NULL)
+		return;
+
+	h = (struct header *) p - 1;
+	ASSERT (h->magic == BLOCK_MAGIC);
+	if (h->class < CLASS_CNT) {
+		b->next = free_lists[h->class];
+		free_lists[h->class] = b;
+	} else {
+		b->next = large_free;
+		large_free = b;
+	}
+}
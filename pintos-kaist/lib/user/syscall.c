@@ -246,6 +246,44 @@ void munmap(void *addr)
 	syscall1(SYS_MUNMAP, addr);
 }
 
+int madvise(void *addr, size_t length, int advice)
+{
+	return syscall3(SYS_MADVISE, addr, length, advice);
+}
+
+int msync(void *addr, size_t length)
+{
+	return syscall2(SYS_MSYNC, addr, length);
+}
+
+/* 힙의 끝을 ADDR로 옮깁니다. 커널은 옮긴 뒤의 끝을 돌려주므로, ADDR과 같아야 성공입니다. */
+int brk(void *addr)
+{
+	return (void *)syscall1(SYS_BRK, addr) == addr ? 0 : -1;
+}
+
+/* 힙을 INCREMENT 바이트 늘리거나 줄이고 이전 끝 주소를 반환합니다. 실패하면 (void *) -1을 반환합니다. */
+void *sbrk(intptr_t increment)
+{
+	uint8_t *old = (uint8_t *)syscall1(SYS_BRK, NULL);
+
+	if (increment != 0 && brk(old + increment) != 0)
+		return (void *)-1;
+	return old;
+}
+
+/* 메모리가 부족해질 때까지 잠들었다가 그때의 빈 유저 페이지 수를 반환합니다. */
+int mem_notify(void)
+{
+	return syscall0(SYS_MEMNOTIFY);
+}
+
+/* 부팅 뒤 흐른 시간을 나노초로 반환합니다. */
+int64_t clock_nanos(void)
+{
+	return syscall0(SYS_CLOCKNANOS);
+}
+
 bool chdir(const char *dir)
 {
 	return syscall1(SYS_CHDIR, dir);
@@ -0,0 +1,38 @@
+/* Checks that the clock_nanos system call is monotonic and finer than a timer tick. */
+
+#include <stdint.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define NS_PER_MS (1000 * 1000)
+#define RUN_NS (50 * NS_PER_MS)
+#define TICK_NS (10 * NS_PER_MS)
+
+void
+test_main (void)
+{
+  int64_t start, prev, now;
+  int64_t min_step = INT64_MAX;
+
+  start = prev = clock_nanos ();
+  if (start <= 0)
+    fail ("clock_nanos returned %lld", start);
+  msg ("read the clock");
+
+  do
+    {
+      now = clock_nanos ();
+      if (now < prev)
+        fail ("clock went backwards: %lld -> %lld", prev, now);
+      if (now > prev && now - prev < min_step)
+        min_step = now - prev;
+      prev = now;
+    }
+  while (now - start < RUN_NS);
+  msg ("clock is monotonic");
+
+  if (min_step >= TICK_NS)
+    fail ("clock only moves in whole ticks");
+  msg ("clock has sub-tick resolution");
+}
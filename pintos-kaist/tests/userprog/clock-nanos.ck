@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(clock-nanos) begin
+(clock-nanos) read the clock
+(clock-nanos) clock is monotonic
+(clock-nanos) clock has sub-tick resolution
+(clock-nanos) end
+clock-nanos: exit(0)
+EOF
+pass;
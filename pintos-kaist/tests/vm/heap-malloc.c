@@ -0,0 +1,89 @@
+/* Grows and shrinks the heap with sbrk and checks malloc, calloc, realloc and free. */
+
+#include <malloc.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define BLOCK_CNT 200
+
+static char *blocks[BLOCK_CNT];
+static size_t sizes[BLOCK_CNT];
+
+static void
+fill (size_t i)
+{
+  memset (blocks[i], i % 251 + 1, sizes[i]);
+}
+
+static void
+verify (size_t i)
+{
+  size_t j;
+
+  for (j = 0; j < sizes[i]; j++)
+    if (blocks[i][j] != (char) (i % 251 + 1))
+      fail ("block %zu byte %zu corrupted", i, j);
+}
+
+void
+test_main (void)
+{
+  char *base, *p;
+  size_t i;
+
+  CHECK ((base = sbrk (0)) != (void *) -1, "sbrk (0)");
+  CHECK (sbrk (8192) == base, "sbrk (8192)");
+  memset (base, 0x5a, 8192);
+  CHECK (sbrk (0) == base + 8192, "break moved up");
+  CHECK (sbrk (-8192) == base + 8192, "sbrk (-8192)");
+  CHECK (sbrk (0) == base, "break moved back");
+  CHECK (sbrk (-4096) == (void *) -1, "sbrk below heap start fails");
+
+  for (i = 0; i < BLOCK_CNT; i++)
+    {
+      sizes[i] = i * 37 % 3000 + 1;
+      if ((blocks[i] = malloc (sizes[i])) == NULL)
+        fail ("malloc (%zu) failed", sizes[i]);
+      fill (i);
+    }
+  for (i = 0; i < BLOCK_CNT; i++)
+    verify (i);
+  msg ("malloc %d blocks", BLOCK_CNT);
+
+  for (i = 0; i < BLOCK_CNT; i += 2)
+    free (blocks[i]);
+  for (i = 0; i < BLOCK_CNT; i += 2)
+    {
+      if ((blocks[i] = malloc (sizes[i])) == NULL)
+        fail ("malloc (%zu) failed", sizes[i]);
+      fill (i);
+    }
+  for (i = 0; i < BLOCK_CNT; i++)
+    verify (i);
+  msg ("free and reuse half of the blocks");
+
+  for (i = 0; i < BLOCK_CNT; i += 3)
+    {
+      if ((p = realloc (blocks[i], sizes[i] * 2)) == NULL)
+        fail ("realloc failed");
+      blocks[i] = p;
+      verify (i);
+      sizes[i] *= 2;
+      fill (i);
+    }
+  for (i = 0; i < BLOCK_CNT; i++)
+    verify (i);
+  msg ("realloc keeps contents");
+
+  CHECK ((p = calloc (1000, 8)) != NULL, "calloc");
+  for (i = 0; i < 8000; i++)
+    if (p[i] != 0)
+      fail ("calloc byte %zu not zero", i);
+  msg ("calloc returns zeroed memory");
+
+  for (i = 0; i < BLOCK_CNT; i++)
+    free (blocks[i]);
+  free (p);
+}
@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(heap-malloc) begin
+(heap-malloc) sbrk (0)
+(heap-malloc) sbrk (8192)
+(heap-malloc) break moved up
+(heap-malloc) sbrk (-8192)
+(heap-malloc) break moved back
+(heap-malloc) sbrk below heap start fails
+(heap-malloc) malloc 200 blocks
+(heap-malloc) free and reuse half of the blocks
+(heap-malloc) realloc keeps contents
+(heap-malloc) calloc
+(heap-malloc) calloc returns zeroed memory
+(heap-malloc) end
+EOF
+pass;
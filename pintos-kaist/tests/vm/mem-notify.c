@@ -0,0 +1,37 @@
+/* Checks that a child waiting in mem_notify wakes up when memory runs low. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define ACTUAL ((void *) 0x10000000)
+#define PAGE_SIZE 4096
+#define PAGE_CNT (16 * 1024 * 1024 / PAGE_SIZE)
+
+void
+test_main (void)
+{
+  pid_t child;
+  int *map;
+  size_t i;
+  int pass;
+
+  child = fork ("notify-child");
+  if (child == 0)
+    {
+      if (mem_notify () < 0)
+        fail ("mem_notify returned a negative count");
+      msg ("woke up on low memory");
+      exit (0);
+    }
+
+  map = mmap (ACTUAL, PAGE_CNT * PAGE_SIZE, true, MAP_ANON, 0);
+  if (map != ACTUAL)
+    fail ("mmap anonymous");
+  for (pass = 0; pass < 2; pass++)
+    for (i = 0; i < PAGE_CNT; i++)
+      map[i * (PAGE_SIZE / sizeof *map)] = i + pass;
+
+  CHECK (wait (child) == 0, "child finished");
+}
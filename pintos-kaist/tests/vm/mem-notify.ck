@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(mem-notify) begin
+(mem-notify) woke up on low memory
+(mem-notify) child finished
+(mem-notify) end
+EOF
+pass;
@@ -0,0 +1,58 @@
+/* Creates anonymous mappings and checks that they read as zeros and keep written data. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define ACTUAL ((void *) 0x10000000)
+#define SIZE (64 * 4096)
+
+static void
+check_zero (const char *map, const char *what)
+{
+  size_t i;
+
+  for (i = 0; i < SIZE; i++)
+    if (map[i] != 0)
+      fail ("byte %zu is %d, not zero", i, map[i]);
+  msg ("%s", what);
+}
+
+static void
+write_and_verify (char *map)
+{
+  size_t i;
+
+  for (i = 0; i < SIZE; i++)
+    map[i] = i % 251 + 1;
+  for (i = 0; i < SIZE; i++)
+    if (map[i] != (char) (i % 251 + 1))
+      fail ("byte %zu differs", i);
+  msg ("verify written data");
+}
+
+void
+test_main (void)
+{
+  char *map;
+
+  CHECK ((map = mmap (ACTUAL, SIZE, 1, MAP_ANON, 0)) != MAP_FAILED,
+         "mmap anonymous");
+  check_zero (map, "anonymous mapping is zero-filled");
+  write_and_verify (map);
+  CHECK (madvise (map, SIZE, MADV_DONTNEED) == 0, "madvise DONTNEED");
+  check_zero (map, "dropped pages read back as zeros");
+  munmap (map);
+
+  CHECK ((map = mmap (ACTUAL, SIZE, 1 | MAP_POPULATE, MAP_ANON, 0))
+         != MAP_FAILED, "mmap anonymous with MAP_POPULATE");
+  check_zero (map, "populated mapping is zero-filled");
+  write_and_verify (map);
+  CHECK (mmap (ACTUAL, 4096, 1, MAP_ANON, 0) == MAP_FAILED,
+         "mmap over existing mapping");
+  munmap (map);
+
+  CHECK (mmap (ACTUAL, 0, 1, MAP_ANON, 0) == MAP_FAILED,
+         "mmap anonymous with zero length");
+}
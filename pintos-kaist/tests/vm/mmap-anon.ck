@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(mmap-anon) begin
+(mmap-anon) mmap anonymous
+(mmap-anon) anonymous mapping is zero-filled
+(mmap-anon) verify written data
+(mmap-anon) madvise DONTNEED
+(mmap-anon) dropped pages read back as zeros
+(mmap-anon) mmap anonymous with MAP_POPULATE
+(mmap-anon) populated mapping is zero-filled
+(mmap-anon) verify written data
+(mmap-anon) mmap over existing mapping
+(mmap-anon) mmap anonymous with zero length
+(mmap-anon) end
+EOF
+pass;
@@ -0,0 +1,76 @@
+/* Checks that madvise advice does not change a file mapping's contents. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define ACTUAL ((void *) 0x10000000)
+#define PAGE_CNT 128
+#define SIZE (PAGE_CNT * 4096)
+
+static char buf[4096];
+
+static char
+expected (size_t i)
+{
+  return (i / 4096 + i) % 251 + 1;
+}
+
+static void
+verify_mapping (const char *what)
+{
+  const char *actual = ACTUAL;
+  size_t i;
+
+  for (i = 0; i < SIZE; i++)
+    if (actual[i] != expected (i))
+      fail ("byte %zu differs %s: expected %d, got %d",
+            i, what, expected (i), actual[i]);
+  msg ("verify mapping %s", what);
+}
+
+void
+test_main (void)
+{
+  int handle;
+  void *map;
+  char *actual = ACTUAL;
+  size_t i, ofs;
+
+  CHECK (create ("madvise.txt", SIZE), "create \"madvise.txt\"");
+  CHECK ((handle = open ("madvise.txt")) > 1, "open \"madvise.txt\"");
+  CHECK ((map = mmap (ACTUAL, SIZE, 1, handle, 0)) != MAP_FAILED,
+         "mmap \"madvise.txt\"");
+
+  CHECK (madvise (map, SIZE, MADV_WILLNEED) == 0, "madvise WILLNEED");
+  for (i = 0; i < SIZE; i++)
+    actual[i] = expected (i);
+
+  CHECK (madvise (map, SIZE, MADV_DONTNEED) == 0, "madvise DONTNEED");
+  verify_mapping ("after DONTNEED");
+
+  CHECK (madvise (map, SIZE, MADV_DONTNEED) == 0, "madvise DONTNEED");
+  CHECK (madvise (map, SIZE, MADV_SEQUENTIAL) == 0, "madvise SEQUENTIAL");
+  verify_mapping ("with SEQUENTIAL");
+
+  CHECK (madvise (map, SIZE, MADV_RANDOM) == 0, "madvise RANDOM");
+  verify_mapping ("with RANDOM");
+
+  /* The dropped pages must have been written back. */
+  for (ofs = 0; ofs < SIZE; ofs += sizeof buf)
+    {
+      if (read (handle, buf, sizeof buf) != sizeof buf)
+        fail ("read at offset %zu failed", ofs);
+      for (i = 0; i < sizeof buf; i++)
+        if (buf[i] != expected (ofs + i))
+          fail ("file byte %zu differs", ofs + i);
+    }
+  msg ("compare file data against written data");
+
+  CHECK (madvise ((void *) 0x20000000, 4096, MADV_WILLNEED) == -1,
+         "madvise unmapped range");
+  CHECK (madvise (map, 4096, 99) == -1, "madvise bad advice");
+  munmap (map);
+  close (handle);
+}
@@ -0,0 +1,23 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(mmap-madvise) begin
+(mmap-madvise) create "madvise.txt"
+(mmap-madvise) open "madvise.txt"
+(mmap-madvise) mmap "madvise.txt"
+(mmap-madvise) madvise WILLNEED
+(mmap-madvise) madvise DONTNEED
+(mmap-madvise) verify mapping after DONTNEED
+(mmap-madvise) madvise DONTNEED
+(mmap-madvise) madvise SEQUENTIAL
+(mmap-madvise) verify mapping with SEQUENTIAL
+(mmap-madvise) madvise RANDOM
+(mmap-madvise) verify mapping with RANDOM
+(mmap-madvise) compare file data against written data
+(mmap-madvise) madvise unmapped range
+(mmap-madvise) madvise bad advice
+(mmap-madvise) end
+EOF
+pass;
@@ -0,0 +1,47 @@
+/* Writes to part of a file mapping, syncs it with msync, and reads the file back. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define ACTUAL ((void *) 0x10000000)
+#define PAGE_CNT 4
+#define SIZE (PAGE_CNT * 4096)
+
+static char buf[SIZE];
+
+static char
+expected (size_t i)
+{
+  return i / 4096 == 2 ? 0 : i % 251 + 1;
+}
+
+void
+test_main (void)
+{
+  int handle;
+  void *map;
+  char *actual = ACTUAL;
+  size_t i;
+
+  CHECK (create ("msync.txt", SIZE), "create \"msync.txt\"");
+  CHECK ((handle = open ("msync.txt")) > 1, "open \"msync.txt\"");
+  CHECK ((map = mmap (ACTUAL, SIZE, 1, handle, 0)) != MAP_FAILED,
+         "mmap \"msync.txt\"");
+  for (i = 0; i < SIZE; i++)
+    if (i / 4096 != 2)
+      actual[i] = expected (i);
+  CHECK (msync (map, SIZE) == 0, "msync \"msync.txt\"");
+
+  /* Read back via read() while the mapping is still in place. */
+  CHECK (read (handle, buf, SIZE) == SIZE, "read \"msync.txt\"");
+  for (i = 0; i < SIZE; i++)
+    if (buf[i] != expected (i))
+      fail ("byte %zu differs: expected %d, got %d", i, expected (i), buf[i]);
+  msg ("compare read data against written data");
+
+  CHECK (msync ((void *) 0x20000000, 4096) == -1, "msync unmapped range");
+  munmap (map);
+  close (handle);
+}
@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(mmap-msync) begin
+(mmap-msync) create "msync.txt"
+(mmap-msync) open "msync.txt"
+(mmap-msync) mmap "msync.txt"
+(mmap-msync) msync "msync.txt"
+(mmap-msync) read "msync.txt"
+(mmap-msync) compare read data against written data
+(mmap-msync) msync unmapped range
+(mmap-msync) end
+EOF
+pass;
@@ -0,0 +1,42 @@
+/* Exhausts memory in a child and checks that only the child is killed. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define ACTUAL ((void *) 0x10000000)
+#define PAGE_SIZE 4096
+#define PAGE_CNT (16 * 1024 * 1024 / PAGE_SIZE)
+
+static char buf[16 * PAGE_SIZE];
+
+void
+test_main (void)
+{
+  pid_t child;
+  size_t i;
+
+  child = fork ("oom-child");
+  if (child == 0)
+    {
+      int *map;
+
+      CHECK ((map = mmap (ACTUAL, PAGE_CNT * PAGE_SIZE, true, MAP_ANON, 0)) == ACTUAL,
+             "mmap anonymous");
+      msg ("touch pages in child");
+      /* Write a different value to each page so that KSM cannot merge them. */
+      for (i = 0; i < PAGE_CNT; i++)
+        map[i * (PAGE_SIZE / sizeof *map)] = i;
+      fail ("child survived after touching %zu pages", i);
+    }
+
+  CHECK (wait (child) == -1, "child was killed");
+
+  for (i = 0; i < sizeof buf; i++)
+    buf[i] = i % 251;
+  for (i = 0; i < sizeof buf; i++)
+    if (buf[i] != (char) (i % 251))
+      fail ("byte %zu differs", i);
+  msg ("parent still runs");
+}
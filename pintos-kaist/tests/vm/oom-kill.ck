@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(oom-kill) begin
+(oom-kill) mmap anonymous
+(oom-kill) touch pages in child
+Out of memory: killed process oom-child
+oom-child: exit(-1)
+(oom-kill) child was killed
+(oom-kill) parent still runs
+(oom-kill) end
+oom-kill: exit(0)
+EOF
+pass;
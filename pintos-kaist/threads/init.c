@@ -20,6 +20,7 @@
 #include "threads/mmu.h"
 #include "threads/palloc.h"
 #include "threads/pte.h"
+#include "threads/slab.h"
 #include "threads/thread.h"
 #ifdef USERPROG
 #include "userprog/process.h"
@@ -31,6 +32,7 @@
 #include "tests/threads/tests.h"
 #ifdef VM
 #include "vm/vm.h"
+#include "vm/zswap.h"
 #endif
 #ifdef FILESYS
 #include "devices/disk.h"
@@ -85,6 +87,7 @@ int main(void)
 	mem_end = palloc_init(); // 페이지 할당자 초기화 (유저/커널 페이지 풀)
 	malloc_init();			 // 커널 heap 초기화
 	paging_init(mem_end);	 // 페이지 테이블 설정 (커널 초기 매핑 포함)
+	pcid_init();			 // CPU가 지원하면 주소 공간마다 PCID 사용
 
 #ifdef USERPROG
 	/* 6. 사용자 프로그램 실행을 위한 환경 설정 */
@@ -237,6 +240,20 @@ parse_options(char **argv)
 			user_page_limit = atoi(value);
 		else if (!strcmp(name, "-threads-tests"))
 			thread_tests = true;
+#endif
+#ifdef VM
+		else if (!strcmp(name, "-wl"))
+			vm_low_watermark = atoi(value);
+		else if (!strcmp(name, "-wh"))
+			vm_high_watermark = atoi(value);
+		else if (!strcmp(name, "-ksm"))
+			vm_ksm_scan_pages = atoi(value);
+		else if (!strcmp(name, "-lp"))
+			vm_large_pages = true;
+		else if (!strcmp(name, "-rss"))
+			vm_rss_limit = atoi(value);
+		else if (!strcmp(name, "-ws"))
+			vm_ws_ticks = atoi(value);
 #endif
 		else
 			PANIC("unknown option `%s' (use -h for help)", name);
@@ -346,6 +363,14 @@ usage(void)
 		   "  -mlfqs             Use multi-level feedback queue scheduler.\n"
 #ifdef USERPROG
 		   "  -ul=COUNT          Limit user memory to COUNT pages.\n"
+#endif
+#ifdef VM
+		   "  -wl=COUNT          Wake pageout daemon below COUNT free user pages.\n"
+		   "  -wh=COUNT          Pageout daemon reclaims up to COUNT free user pages.\n"
+		   "  -ksm=COUNT         KSM scanner checks COUNT frames per wakeup (0 disables).\n"
+		   "  -lp                Map untouched 2MB-aligned zero-fill regions with large pages.\n"
+		   "  -rss=COUNT         Limit each process to COUNT resident frames (0 = no limit).\n"
+		   "  -ws=TICKS          Sample working sets every TICKS timer ticks (0 disables).\n"
 #endif
 	);
 	power_off();
@@ -380,5 +405,10 @@ print_stats(void)
 	kbd_print_stats();
 #ifdef USERPROG
 	exception_print_stats();
+#endif
+	kmem_cache_print_stats();
+#ifdef VM
+	zswap_print_stats();
+	vm_ksm_print_stats();
 #endif
 }
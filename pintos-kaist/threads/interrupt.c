@@ -13,6 +13,7 @@
 #include "intrinsic.h"
 #ifdef USERPROG
 #include "userprog/gdt.h"
+#include "userprog/process.h"
 #endif
 
 /* Number of x86_64 interrupts. */
@@ -371,6 +372,12 @@ intr_handler (struct intr_frame *frame) {
 		if (yield_on_return)
 			thread_yield ();
 	}
+
+#ifdef USERPROG
+	/* 종료를 요청받은 유저 프로세스는 유저 모드로 돌아가지 않고 여기서 끝냅니다. */
+	if (frame->cs == SEL_UCSEG && thread_current ()->killed)
+		process_kill ();
+#endif
 }
 
 /* Dumps interrupt frame F to the console, for debugging. */
@@ -8,12 +8,161 @@
 #include "threads/mmu.h"
 #include "intrinsic.h"
 
+/* PCID(Process-Context ID)
+ * CPU가 지원하면 주소 공간마다 12비트 ID를 붙여서, CR3를 바꿀 때 다른 주소 공간의 TLB 항목을 남겨 둡니다.
+ * ID는 pml4 페이지에서 쓰지 않는 마지막 엔트리에 present 비트 없이 적어 둡니다.
+ * 0번은 base_pml4와 ID를 받지 못한 주소 공간이 쓰며, 이 경우에는 전환할 때마다 예전처럼 비웁니다.
+ * 현재 주소 공간이 아닌 pml4의 매핑을 바꾸면 INVPCID로 그 항목만 지우고,
+ * INVPCID가 없으면 다음에 활성화할 때 그 ID의 항목을 모두 비우도록 표시해 둡니다. */
+#define PCID_CNT 4096
+#define PML4_PCID_SLOT 511
+#define CR3_NOFLUSH (1ULL << 63)
+#define CR4_PCIDE (1 << 17)
+#define CPUID_1_ECX_PCID (1 << 17)
+#define CPUID_7_EBX_INVPCID (1 << 10)
+#define INVPCID_ADDR 0
+#define INVPCID_CONTEXT 1
+
+static bool pcid_enabled;
+static bool invpcid_enabled;
+static bool pcid_used[PCID_CNT];
+static bool pcid_stale[PCID_CNT]; /* 다음 활성화 때 비워야 하는 ID */
+static unsigned pcid_next = 1;
+
+static unsigned
+pml4_pcid(uint64_t *pml4)
+{
+	return (pml4[PML4_PCID_SLOT] >> PTXSHIFT) & (PCID_CNT - 1);
+}
+
+/* 새 주소 공간에 줄 ID를 고릅니다. 다 쓰고 있으면 0을 반환합니다. */
+static unsigned
+pcid_alloc(void)
+{
+	unsigned pcid = 0;
+
+	if (!pcid_enabled)
+		return 0;
+
+	enum intr_level old_level = intr_disable();
+	for (unsigned i = 0; i < PCID_CNT - 1; i++)
+	{
+		unsigned cand = (pcid_next + i - 1) % (PCID_CNT - 1) + 1;
+		if (!pcid_used[cand])
+		{
+			pcid = cand;
+			pcid_used[pcid] = true;
+			/* 전에 이 ID를 쓴 주소 공간의 항목이 남아 있을 수 있습니다. */
+			pcid_stale[pcid] = true;
+			pcid_next = pcid % (PCID_CNT - 1) + 1;
+			break;
+		}
+	}
+	intr_set_level(old_level);
+	return pcid;
+}
+
+/* CPU가 PCID를 지원하면 CR4.PCIDE를 켭니다. paging_init() 직후, PCID 0인 base_pml4가
+ * 활성화된 상태에서 호출해야 합니다. QEMU의 기본 CPU 모델처럼 지원하지 않으면 아무것도 하지 않습니다. */
+void pcid_init(void)
+{
+	uint32_t regs[4];
+
+	cpuid(0, 0, regs);
+	uint32_t max_leaf = regs[0];
+	cpuid(1, 0, regs);
+	if (!(regs[2] & CPUID_1_ECX_PCID))
+		return;
+	if (max_leaf >= 7)
+	{
+		cpuid(7, 0, regs);
+		invpcid_enabled = (regs[1] & CPUID_7_EBX_INVPCID) != 0;
+	}
+
+	ASSERT(base_pml4[PML4_PCID_SLOT] == 0);
+	ASSERT((rcr3() & PTE_FLAGS) == 0);
+	lcr4(rcr4() | CR4_PCIDE);
+	pcid_enabled = true;
+}
+
+/* PML4가 지금 CR3에 올라가 있으면 true를 반환합니다. */
+static bool
+pml4_is_active(uint64_t *pml4)
+{
+	return PTE_ADDR(rcr3()) == vtop(pml4);
+}
+
+/* PML4에서 가상 주소 VA의 TLB 항목을 무효화합니다.
+ * PCID가 없으면 다른 주소 공간의 항목은 전환할 때 모두 비워지므로 현재 주소 공간만 챙깁니다. */
+static void
+tlb_invalidate(uint64_t *pml4, uint64_t va)
+{
+	if (pml4_is_active(pml4))
+		invlpg(va);
+	else if (pcid_enabled && pml4_pcid(pml4) != 0)
+	{
+		if (invpcid_enabled)
+			invpcid(INVPCID_ADDR, pml4_pcid(pml4), va);
+		else
+			pcid_stale[pml4_pcid(pml4)] = true;
+	}
+}
+
+/* PML4의 TLB 항목과 페이징 구조 캐시를 모두 무효화합니다. */
+static void
+tlb_invalidate_all(uint64_t *pml4)
+{
+	if (pml4_is_active(pml4))
+		lcr3(rcr3());
+	else if (pcid_enabled && pml4_pcid(pml4) != 0)
+	{
+		if (invpcid_enabled)
+			invpcid(INVPCID_CONTEXT, pml4_pcid(pml4), 0);
+		else
+			pcid_stale[pml4_pcid(pml4)] = true;
+	}
+}
+
+/* PML4에 속한 2MB 큰 페이지를 매핑한 PDE를 같은 권한의 4KB PTE 512개로 쪼갭니다.
+ * accessed/dirty 비트도 각 PTE로 그대로 옮깁니다. 메모리가 없으면 false를 반환합니다. */
+static bool
+pde_split(uint64_t *pml4, uint64_t *pde)
+{
+	uint64_t *pt = palloc_get_page(0);
+	if (pt == NULL)
+		return false;
+
+	uint64_t pa = PTE_ADDR(*pde) & ~(LARGE_PGSIZE - 1);
+	uint64_t flags = *pde & PTE_FLAGS & ~PTE_PS;
+	for (unsigned i = 0; i < LARGE_PGCNT; i++)
+		pt[i] = (pa + i * PGSIZE) | flags;
+	*pde = vtop(pt) | PTE_U | PTE_W | PTE_P;
+
+	/* 큰 페이지의 TLB 항목과 페이징 구조 캐시를 모두 비웁니다.
+	 * 지금 올라와 있지 않은 PML4라도 PCID로 남아 있는 항목까지 비웁니다. */
+	tlb_invalidate_all(pml4);
+	return true;
+}
+
 static uint64_t *
-pgdir_walk(uint64_t *pdp, const uint64_t va, int create)
+pgdir_walk(uint64_t *pml4, uint64_t *pdp, const uint64_t va, int create)
 {
 	int idx = PDX(va);
 	if (pdp)
 	{
+		/* 큰 페이지는 PDE가 곧 엔트리입니다. 조회만 할 때는 PDE를 그대로 돌려주고,
+		 * 4KB 엔트리를 만들거나 고칠 때(CREATE)는 먼저 쪼갭니다.
+		 * 이미 내려간 큰 페이지는 쪼갤 것이 없으므로 빈 PDE로 보고 새 테이블을 만듭니다. */
+		if (pdp[idx] & PTE_PS)
+		{
+			if (!create)
+				return &pdp[idx];
+			if (!(pdp[idx] & PTE_P))
+				pdp[idx] = 0;
+			else if (!pde_split(pml4, &pdp[idx]))
+				return NULL;
+		}
+
 		uint64_t *pte = (uint64_t *)pdp[idx];
 		if (!((uint64_t)pte & PTE_P))
 		{
@@ -34,7 +183,7 @@ pgdir_walk(uint64_t *pdp, const uint64_t va, int create)
 }
 
 static uint64_t *
-pdpe_walk(uint64_t *pdpe, const uint64_t va, int create)
+pdpe_walk(uint64_t *pml4, uint64_t *pdpe, const uint64_t va, int create)
 {
 	uint64_t *pte = NULL;
 	int idx = PDPE(va);
@@ -58,7 +207,7 @@ pdpe_walk(uint64_t *pdpe, const uint64_t va, int create)
 			else
 				return NULL;
 		}
-		pte = pgdir_walk(ptov(PTE_ADDR(pdpe[idx])), va, create);
+		pte = pgdir_walk(pml4, ptov(PTE_ADDR(pdpe[idx])), va, create);
 	}
 	if (pte == NULL && allocated)
 	{
@@ -99,7 +248,7 @@ pml4e_walk(uint64_t *pml4e, const uint64_t va, int create)
 			else
 				return NULL;
 		}
-		pte = pdpe_walk(ptov(PTE_ADDR(pml4e[idx])), va, create);
+		pte = pdpe_walk(pml4e, ptov(PTE_ADDR(pml4e[idx])), va, create);
 	}
 	if (pte == NULL && allocated)
 	{
@@ -118,7 +267,10 @@ pml4_create(void)
 {
 	uint64_t *pml4 = palloc_get_page(0);
 	if (pml4)
+	{
 		memcpy(pml4, base_pml4, PGSIZE);
+		pml4[PML4_PCID_SLOT] = (uint64_t)pcid_alloc() << PTXSHIFT;
+	}
 	return pml4;
 }
 
@@ -149,6 +301,9 @@ pgdir_for_each(uint64_t *pdp, pte_for_each_func *func, void *aux,
 	for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++)
 	{
 		uint64_t *pte = ptov((uint64_t *)pdp[i]);
+		/* 큰 페이지는 VM에서만 만들고, pml4_for_each는 VM이 아닐 때만 쓰므로 건너뜁니다. */
+		if (pdp[i] & PTE_PS)
+			continue;
 		if (((uint64_t)pte) & PTE_P)
 			if (!pt_for_each((uint64_t *)PTE_ADDR(pte), func, aux,
 							 pml4_index, pdp_index, i))
@@ -203,7 +358,11 @@ pgdir_destroy(uint64_t *pdp)
 	for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++)
 	{
 		uint64_t *pte = ptov((uint64_t *)pdp[i]);
-		if (((uint64_t)pte) & PTE_P)
+		if (!(((uint64_t)pte) & PTE_P))
+			continue;
+		if (pdp[i] & PTE_PS)
+			palloc_free_multiple((void *)PTE_ADDR(pte), LARGE_PGCNT);
+		else
 			pt_destroy(PTE_ADDR(pte));
 	}
 	palloc_free_page((void *)pdp);
@@ -232,14 +391,35 @@ void pml4_destroy(uint64_t *pml4)
 	uint64_t *pdpe = ptov((uint64_t *)pml4[0]);
 	if (((uint64_t)pdpe) & PTE_P)
 		pdpe_destroy((void *)PTE_ADDR(pdpe));
+
+	/* ID를 돌려줍니다. 남은 TLB 항목은 다음 주인이 처음 활성화할 때 비워집니다. */
+	if (pml4_pcid(pml4) != 0)
+		pcid_used[pml4_pcid(pml4)] = false;
 	palloc_free_page((void *)pml4);
 }
 
 /* Loads page directory PD into the CPU's page directory base
  * register. */
+/* PCID가 있으면 주소 공간의 ID를 함께 싣고, 비울 필요가 없으면 no-flush 비트를 켭니다. */
 void pml4_activate(uint64_t *pml4)
 {
-	lcr3(vtop(pml4 ? pml4 : base_pml4));
+	if (pml4 == NULL)
+		pml4 = base_pml4;
+
+	uint64_t cr3 = vtop(pml4);
+	if (pcid_enabled && pml4 != base_pml4)
+	{
+		unsigned pcid = pml4_pcid(pml4);
+		cr3 |= pcid;
+		if (pcid != 0)
+		{
+			if (pcid_stale[pcid])
+				pcid_stale[pcid] = false;
+			else
+				cr3 |= CR3_NOFLUSH;
+		}
+	}
+	lcr3(cr3);
 }
 
 /* pml4에서 사용자 가상 주소 UADDR에 해당하는 물리 주소를 조회합니다.
@@ -253,7 +433,11 @@ pml4_get_page(uint64_t *pml4, const void *uaddr)
 	uint64_t *pte = pml4e_walk(pml4, (uint64_t)uaddr, 0);
 
 	if (pte && (*pte & PTE_P))
+	{
+		if (*pte & PTE_PS)
+			return ptov(PTE_ADDR(*pte) & ~(LARGE_PGSIZE - 1)) + ((uint64_t)uaddr & (LARGE_PGSIZE - 1));
 		return ptov(PTE_ADDR(*pte)) + pg_ofs(uaddr);
+	}
 	return NULL;
 }
 
@@ -271,7 +455,13 @@ bool pml4_set_page(uint64_t *pml4, void *upage, void *kpage, bool rw)
 	uint64_t *pte = pml4e_walk(pml4, (uint64_t)upage, 1);
 
 	if (pte)
+	{
+		/* 있던 매핑을 바꾸는 경우(COW 쓰기 금지 등) 옛 항목이 TLB에 남지 않게 합니다. */
+		bool was_present = (*pte & PTE_P) != 0;
 		*pte = vtop(kpage) | PTE_P | (rw ? PTE_W : 0) | PTE_U;
+		if (was_present)
+			tlb_invalidate(pml4, (uint64_t)upage);
+	}
 	return pte != NULL;
 }
 
@@ -287,14 +477,217 @@ void pml4_clear_page(uint64_t *pml4, void *upage)
 
 	pte = pml4e_walk(pml4, (uint64_t)upage, false);
 
+	/* 큰 페이지의 일부만 지울 때는 4KB로 쪼갠 뒤 해당 PTE만 지웁니다.
+	 * 이미 내려간 큰 페이지(프로세스 종료 때 pml4_clear_range()가 지운 것 등)는 쪼개지 않습니다. */
+	if (pte != NULL && (*pte & PTE_PS) != 0)
+	{
+		if ((*pte & PTE_P) == 0)
+			return;
+		pte = pml4e_walk(pml4, (uint64_t)upage, true);
+	}
+
 	if (pte != NULL && (*pte & PTE_P) != 0)
 	{
 		*pte &= ~PTE_P;
-		if (rcr3() == vtop(pml4))
-			invlpg((uint64_t)upage);
+		tlb_invalidate(pml4, (uint64_t)upage);
 	}
 }
 
+/* 2MB 정렬된 UPAGE부터 LARGE_PGSIZE 만큼을, 역시 2MB 정렬된 연속 물리 페이지 KPAGE에
+ * PS 비트를 켠 PDE 하나로 매핑합니다. TLB 항목 하나로 512 페이지를 덮습니다.
+ * 이 구간에 이미 4KB로 매핑된 페이지가 있거나 메모리가 없으면 false를 반환합니다.
+ * 이후 일부 페이지를 pml4_set_page()나 pml4_clear_page()로 고치면 자동으로 쪼개집니다. */
+bool pml4_set_large_page(uint64_t *pml4, void *upage, void *kpage, bool rw)
+{
+	ASSERT((uint64_t)upage % LARGE_PGSIZE == 0);
+	ASSERT(vtop(kpage) % LARGE_PGSIZE == 0);
+	ASSERT(is_user_vaddr(upage));
+	ASSERT(pml4 != base_pml4);
+
+	/* 상위 단계 테이블은 4KB 경로로 만들어 두고, 그 PDE를 직접 바꿉니다. */
+	if (pml4e_walk(pml4, (uint64_t)upage, 1) == NULL)
+		return false;
+	uint64_t *pdpe = ptov(PTE_ADDR(pml4[PML4(upage)]));
+	uint64_t *pd = ptov(PTE_ADDR(pdpe[PDPE(upage)]));
+	uint64_t *pde = &pd[PDX(upage)];
+	uint64_t *pt = ptov(PTE_ADDR(*pde));
+
+	for (unsigned i = 0; i < LARGE_PGCNT; i++)
+		if (pt[i] & PTE_P)
+			return false;
+
+	*pde = vtop(kpage) | PTE_P | PTE_PS | PTE_U | (rw ? PTE_W : 0);
+	palloc_free_page(pt);
+	tlb_invalidate_all(pml4);
+	return true;
+}
+
+/* 범위 연산
+ * [START, END)를 단계마다 한 번씩만 내려가며 훑고, 비어 있는 하위 테이블은 통째로 건너뜁니다.
+ * 그래서 비용은 구간 크기가 아니라 실제로 매핑된 페이지 수에 비례합니다.
+ * 무효화할 주소는 TLB_BATCH개까지 모아 두었다가 끝에 한꺼번에 비우고,
+ * 그보다 많으면 invlpg를 여러 번 하는 것보다 싸므로 주소 공간 전체를 한 번 비웁니다. */
+#define TLB_BATCH 32
+
+enum range_op
+{
+	RANGE_CLEAR,   /* present 비트를 끕니다. */
+	RANGE_PROTECT, /* 쓰기 비트를 RW에 맞춥니다. */
+	RANGE_DIRTY,   /* dirty 비트가 켜진 엔트리가 있는지 봅니다. */
+};
+
+struct range_walk
+{
+	uint64_t *pml4; /* 훑는 PML4. 큰 페이지를 쪼갤 때 TLB를 비우는 데 씁니다. */
+	enum range_op op;
+	bool rw;
+	bool dirty;
+	size_t flush_cnt;
+	uint64_t flush[TLB_BATCH];
+};
+
+/* VA가 속한 SHIFT 단계 엔트리가 덮는 구간의 끝과 END 중 앞선 쪽을 반환합니다. */
+static uint64_t
+range_next(uint64_t va, unsigned shift, uint64_t end)
+{
+	uint64_t next = (va | ((1ULL << shift) - 1)) + 1;
+	return next < end ? next : end;
+}
+
+/* 엔트리 E(PTE나 큰 페이지 PDE) 하나에 연산을 적용합니다. */
+static void
+range_apply(uint64_t *e, uint64_t va, struct range_walk *w)
+{
+	uint64_t old = *e;
+
+	switch (w->op)
+	{
+	case RANGE_CLEAR:
+		*e &= ~PTE_P;
+		break;
+	case RANGE_PROTECT:
+		if (w->rw)
+			*e |= PTE_W;
+		else
+			*e &= ~PTE_W;
+		break;
+	case RANGE_DIRTY:
+		if (*e & PTE_D)
+			w->dirty = true;
+		return;
+	}
+
+	if ((old & PTE_P) && *e != old)
+	{
+		if (w->flush_cnt < TLB_BATCH)
+			w->flush[w->flush_cnt] = va;
+		w->flush_cnt++;
+	}
+}
+
+static void
+range_walk_pt(uint64_t *pt, uint64_t va, uint64_t end, struct range_walk *w)
+{
+	for (; va < end; va += PGSIZE)
+		range_apply(&pt[PTX(va)], va, w);
+}
+
+static void
+range_walk_pd(uint64_t *pd, uint64_t va, uint64_t end, struct range_walk *w)
+{
+	while (va < end)
+	{
+		uint64_t next = range_next(va, PDXSHIFT, end);
+		uint64_t *pde = &pd[PDX(va)];
+
+		/* 큰 페이지가 통째로 범위에 들거나 읽기만 하면 PDE 하나로 처리하고,
+		 * 일부만 고쳐야 하면 4KB로 쪼갭니다. 쪼갤 메모리가 없으면 pml4_clear_page()처럼 건너뜁니다. */
+		if ((*pde & (PTE_PS | PTE_P)) == PTE_PS && w->op != RANGE_DIRTY)
+		{
+			/* 내려간 큰 페이지에는 지우거나 쓰기 금지할 엔트리가 없습니다. */
+			va = next;
+			continue;
+		}
+		if (*pde & PTE_PS)
+		{
+			if (w->op == RANGE_DIRTY || (va % LARGE_PGSIZE == 0 && next - va == LARGE_PGSIZE))
+			{
+				range_apply(pde, va, w);
+				va = next;
+				continue;
+			}
+			if (!pde_split(w->pml4, pde))
+			{
+				va = next;
+				continue;
+			}
+		}
+		if (*pde & PTE_P)
+			range_walk_pt(ptov(PTE_ADDR(*pde)), va, next, w);
+		va = next;
+	}
+}
+
+static void
+range_walk_pdp(uint64_t *pdp, uint64_t va, uint64_t end, struct range_walk *w)
+{
+	while (va < end)
+	{
+		uint64_t next = range_next(va, PDPESHIFT, end);
+		if (pdp[PDPE(va)] & PTE_P)
+			range_walk_pd(ptov(PTE_ADDR(pdp[PDPE(va)])), va, next, w);
+		va = next;
+	}
+}
+
+/* PML4의 사용자 구간 [START, END)에 W의 연산을 적용하고 모아 둔 TLB 항목을 비웁니다. */
+static void
+range_walk(uint64_t *pml4, void *start, void *end, struct range_walk *w)
+{
+	ASSERT(pg_ofs(start) == 0 && pg_ofs(end) == 0);
+	ASSERT(start <= end && (uint64_t)end <= KERN_BASE);
+
+	w->pml4 = pml4;
+	for (uint64_t va = (uint64_t)start; va < (uint64_t)end;)
+	{
+		uint64_t next = range_next(va, PML4SHIFT, (uint64_t)end);
+		if (pml4[PML4(va)] & PTE_P)
+			range_walk_pdp(ptov(PTE_ADDR(pml4[PML4(va)])), va, next, w);
+		va = next;
+	}
+
+	if (w->flush_cnt > TLB_BATCH)
+		tlb_invalidate_all(pml4);
+	else
+		for (size_t i = 0; i < w->flush_cnt; i++)
+			tlb_invalidate(pml4, w->flush[i]);
+}
+
+/* PML4에서 [START, END)의 모든 매핑을 "존재하지 않음"으로 표시합니다.
+ * pml4_clear_page()를 페이지마다 부르는 것과 같지만 테이블을 한 번만 훑습니다.
+ * dirty 비트를 비롯한 다른 비트는 그대로 남으므로 이후 write-back 판단에 쓸 수 있습니다. */
+void pml4_clear_range(uint64_t *pml4, void *start, void *end)
+{
+	struct range_walk w = {.op = RANGE_CLEAR};
+	range_walk(pml4, start, end, &w);
+}
+
+/* PML4에서 [START, END)에 매핑된 페이지의 쓰기 권한을 RW로 바꿉니다.
+ * accessed/dirty 비트는 유지됩니다. */
+void pml4_protect_range(uint64_t *pml4, void *start, void *end, bool rw)
+{
+	struct range_walk w = {.op = RANGE_PROTECT, .rw = rw};
+	range_walk(pml4, start, end, &w);
+}
+
+/* PML4에서 [START, END)에 dirty 비트가 켜진 페이지가 하나라도 있으면 true를 반환합니다. */
+bool pml4_is_dirty_range(uint64_t *pml4, void *start, void *end)
+{
+	struct range_walk w = {.op = RANGE_DIRTY};
+	range_walk(pml4, start, end, &w);
+	return w.dirty;
+}
+
 /* 가상 페이지 VPAGE에 대한 PML4의 PTE가 dirty(수정됨) 상태이면 true를 반환합니다.
  * 즉, PTE가 설치된 이후 해당 페이지가 수정된 적이 있으면 true를 반환합니다.
  * PML4에 VPAGE에 대한 PTE가 없으면 false를 반환합니다. */
@@ -316,8 +709,7 @@ void pml4_set_dirty(uint64_t *pml4, const void *vpage, bool dirty)
 		else
 			*pte &= ~(uint32_t)PTE_D;
 
-		if (rcr3() == vtop(pml4))
-			invlpg((uint64_t)vpage);
+		tlb_invalidate(pml4, (uint64_t)vpage);
 	}
 }
 
@@ -342,7 +734,6 @@ void pml4_set_accessed(uint64_t *pml4, const void *vpage, bool accessed)
 		else
 			*pte &= ~(uint32_t)PTE_A;
 
-		if (rcr3() == vtop(pml4))
-			invlpg((uint64_t)vpage);
+		tlb_invalidate(pml4, (uint64_t)vpage);
 	}
 }
@@ -8,6 +8,7 @@
 #include <stdio.h>
 #include <string.h>
 #include "threads/init.h"
+#include "threads/interrupt.h"
 #include "threads/loader.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
@@ -31,6 +32,7 @@ struct pool {
 	struct lock lock;               /* Mutual exclusion. */
 	struct bitmap *used_map;        /* Bitmap of free pages. */
 	uint8_t *base;                  /* Base of pool. */
+	size_t free_cnt;                /* 남아 있는 빈 페이지 수. */
 };
 
 /* Two pools: one for kernel data, one for user pages. */
@@ -42,6 +44,7 @@ static void
 init_pool (struct pool *p, void **bm_base, uint64_t start, uint64_t end);
 
 static bool page_from_pool (const struct pool *, void *page);
+static void pool_adjust_free_cnt (struct pool *, long delta);
 
 /* multiboot info */
 struct multiboot_info {
@@ -232,6 +235,11 @@ split:
 			}
 		}
 	}
+
+	kernel_pool.free_cnt = bitmap_count (kernel_pool.used_map, 0,
+			bitmap_size (kernel_pool.used_map), false);
+	user_pool.free_cnt = bitmap_count (user_pool.used_map, 0,
+			bitmap_size (user_pool.used_map), false);
 }
 
 /* Initializes the page allocator and get the memory size */
@@ -267,6 +275,8 @@ palloc_get_multiple (enum palloc_flags flags, size_t page_cnt) {
 
 	lock_acquire (&pool->lock);
 	size_t page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
+	if (page_idx != BITMAP_ERROR)
+		pool_adjust_free_cnt (pool, -(long) page_cnt);
 	lock_release (&pool->lock);
 	void *pages;
 
@@ -286,6 +296,40 @@ palloc_get_multiple (enum palloc_flags flags, size_t page_cnt) {
 	return pages;
 }
 
+/* palloc_get_multiple()과 같지만, 반환 주소가 PAGE_CNT * PGSIZE 경계에 정렬된
+   연속 페이지를 얻습니다. PAGE_CNT는 2의 거듭제곱이어야 합니다.
+   큰 페이지(2MB) 매핑에 쓰며, 풀이 조각나 있으면 널 포인터를 반환합니다. */
+void *
+palloc_get_aligned (enum palloc_flags flags, size_t page_cnt) {
+	struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+	size_t align = page_cnt * PGSIZE;
+	size_t page_idx = BITMAP_ERROR;
+	void *pages = NULL;
+
+	ASSERT (page_cnt > 0 && (page_cnt & (page_cnt - 1)) == 0);
+
+	/* 풀의 시작이 정렬되어 있지 않을 수 있으므로 첫 정렬 위치부터 PAGE_CNT씩 건너뜁니다. */
+	size_t first = (ROUND_UP ((uintptr_t) pool->base, align) - (uintptr_t) pool->base) / PGSIZE;
+	size_t pool_cnt = bitmap_size (pool->used_map);
+
+	lock_acquire (&pool->lock);
+	for (size_t i = first; i + page_cnt <= pool_cnt; i += page_cnt)
+		if (bitmap_none (pool->used_map, i, page_cnt)) {
+			bitmap_set_multiple (pool->used_map, i, page_cnt, true);
+			pool_adjust_free_cnt (pool, -(long) page_cnt);
+			page_idx = i;
+			break;
+		}
+	lock_release (&pool->lock);
+
+	if (page_idx != BITMAP_ERROR) {
+		pages = pool->base + PGSIZE * page_idx;
+		if (flags & PAL_ZERO)
+			memset (pages, 0, PGSIZE * page_cnt);
+	} else if (flags & PAL_ASSERT)
+		PANIC ("palloc_get: out of pages");
+	return pages;
+}
 
 /* 빈 페이지 한 개를 얻어 그 커널 가상 주소를 반환합니다.
    PAL_USER가 설정되어 있으면 유저 풀에서, 아니면 커널 풀에서 할당합니다.
@@ -322,6 +366,7 @@ palloc_free_multiple (void *pages, size_t page_cnt) {
 #endif
 	ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
 	bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+	pool_adjust_free_cnt (pool, page_cnt);
 }
 
 /* Frees the page at PAGE. */
@@ -330,6 +375,28 @@ palloc_free_page (void *page) {
 	palloc_free_multiple (page, 1);
 }
 
+/* 유저 풀에 남아 있는 빈 페이지 수를 반환합니다.
+   pageout 데몬이 워터마크와 비교할 때 사용하며, 대략적인 값이어도 괜찮습니다. */
+size_t
+palloc_user_free_pages (void) {
+	return user_pool.free_cnt;
+}
+
+/* 유저 풀 전체 페이지 수를 반환합니다. */
+size_t
+palloc_user_pages (void) {
+	return bitmap_size (user_pool.used_map);
+}
+
+/* POOL의 빈 페이지 수를 DELTA만큼 조정합니다.
+   palloc_free_multiple()은 스케줄러 안에서도 불리므로 락 대신 인터럽트를 끕니다. */
+static void
+pool_adjust_free_cnt (struct pool *pool, long delta) {
+	enum intr_level old_level = intr_disable ();
+	pool->free_cnt += delta;
+	intr_set_level (old_level);
+}
+
 /* 풀 P를 START에서 시작하여 END에서 끝나도록 초기화합니다. */
 static void
 init_pool (struct pool *p, void **bm_base, uint64_t start, uint64_t end) {
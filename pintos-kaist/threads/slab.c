@@ -0,0 +1,212 @@
+#include "threads/slab.h"
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "threads/interrupt.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+/* 고정 크기 커널 객체를 위한 슬랩 할당자.
+
+   struct page, struct frame처럼 자주 만들고 지우는 같은 크기의 객체는
+   malloc()의 크기별 디스크립터를 거치지 않고 타입별 캐시에서 바로 꺼내 씁니다.
+
+   캐시는 슬랩(커널 풀 페이지 한 장)들을 가지고 있습니다. 슬랩의 맨 앞에는
+   struct slab 헤더가 있고, 나머지는 같은 크기의 객체 칸으로 나뉩니다.
+   빈 칸은 슬랩마다 단일 연결 리스트로 묶여 있으므로 할당과 해제 모두 O(1)이며,
+   해제할 때는 객체 주소를 페이지 단위로 내림하면 슬랩 헤더를 바로 찾을 수 있습니다.
+
+   생성자(ctor)는 슬랩을 만들 때 각 칸에 한 번만 호출됩니다.
+   따라서 객체는 해제할 때 생성자가 만든 상태로 되돌려 놓아야 합니다.
+
+   임계 구역이 짧으므로 락 대신 인터럽트를 끕니다. lock_acquire() 안에서
+   donation 객체를 할당하기 때문에, 여기서 락을 쓰면 재귀에 빠질 수 있습니다. */
+
+/* 캐시 하나. */
+struct kmem_cache {
+	const char *name;               /* 통계 출력용 이름. */
+	size_t obj_size;                /* 칸 하나의 크기 (8바이트 정렬). */
+	size_t link_ofs;                /* 칸 안에서 빈 칸 연결 포인터의 위치. */
+	size_t objs_per_slab;           /* 슬랩 하나에 들어가는 칸 수. */
+	void (*ctor) (void *);          /* 생성자, 없으면 NULL. */
+
+	struct list partial;            /* 빈 칸이 남아 있는 슬랩. */
+	struct list full;               /* 빈 칸이 없는 슬랩. */
+
+	/* 통계. */
+	size_t active;                  /* 사용 중인 객체 수. */
+	size_t slab_cnt;                /* 가지고 있는 슬랩 수. */
+	size_t alloc_cnt;               /* kmem_cache_alloc() 호출 수. */
+	size_t hit_cnt;                 /* 새 슬랩 없이 처리한 할당 수. */
+};
+
+/* Magic number for detecting slab corruption. */
+#define SLAB_MAGIC 0x51ab51ab
+
+/* 슬랩 헤더. 페이지의 맨 앞에 위치합니다. */
+struct slab {
+	unsigned magic;                 /* Always set to SLAB_MAGIC. */
+	struct kmem_cache *cache;       /* 소속 캐시. */
+	struct list_elem elem;          /* partial 또는 full 리스트의 원소. */
+	size_t free_cnt;                /* 빈 칸 수. */
+	void *free_list;                /* 첫 번째 빈 칸. */
+};
+
+/* 캐시들. 정적으로 두어서 malloc_init() 전에도 만들 수 있습니다. */
+static struct kmem_cache caches[8];
+static size_t cache_cnt;
+
+static struct slab *slab_create (struct kmem_cache *);
+static struct slab *obj_to_slab (void *);
+static void **obj_link (struct kmem_cache *, void *);
+
+/* SIZE 바이트짜리 객체를 위한 캐시를 만듭니다.
+   CTOR가 NULL이 아니면 슬랩을 만들 때 각 객체에 호출합니다. */
+struct kmem_cache *
+kmem_cache_create (const char *name, size_t size, void (*ctor) (void *)) {
+	struct kmem_cache *c;
+
+	ASSERT (cache_cnt < sizeof caches / sizeof *caches);
+	ASSERT (size > 0);
+
+	c = &caches[cache_cnt++];
+	c->name = name;
+	c->obj_size = ROUND_UP (size < sizeof (void *) ? sizeof (void *) : size, 8);
+	c->link_ofs = 0;
+	if (ctor != NULL) {
+		/* 생성자가 만든 상태를 덮어쓰지 않도록 연결 포인터를 칸 뒤에 붙입니다. */
+		c->link_ofs = c->obj_size;
+		c->obj_size += sizeof (void *);
+	}
+	c->objs_per_slab = (PGSIZE - ROUND_UP (sizeof (struct slab), 8)) / c->obj_size;
+	ASSERT (c->objs_per_slab > 0);
+	c->ctor = ctor;
+	list_init (&c->partial);
+	list_init (&c->full);
+	c->active = c->slab_cnt = c->alloc_cnt = c->hit_cnt = 0;
+	return c;
+}
+
+/* 캐시 C에서 객체 하나를 할당합니다. 메모리가 없으면 널 포인터를 반환합니다. */
+void *
+kmem_cache_alloc (struct kmem_cache *c) {
+	struct slab *s;
+	void *obj;
+	enum intr_level old_level;
+
+	old_level = intr_disable ();
+	c->alloc_cnt++;
+	if (list_empty (&c->partial)) {
+		/* 페이지 할당은 락을 잡으므로 인터럽트를 켠 상태로 합니다. */
+		intr_set_level (old_level);
+		s = slab_create (c);
+		if (s == NULL)
+			return NULL;
+		old_level = intr_disable ();
+		list_push_front (&c->partial, &s->elem);
+		c->slab_cnt++;
+	} else
+		c->hit_cnt++;
+
+	s = list_entry (list_front (&c->partial), struct slab, elem);
+	obj = s->free_list;
+	s->free_list = *obj_link (c, obj);
+	if (--s->free_cnt == 0) {
+		list_remove (&s->elem);
+		list_push_back (&c->full, &s->elem);
+	}
+	c->active++;
+	intr_set_level (old_level);
+	return obj;
+}
+
+/* 캐시 C에서 할당한 OBJ를 해제합니다. OBJ가 널 포인터면 아무것도 하지 않습니다.
+   슬랩이 통째로 비면 페이지를 돌려줍니다. */
+void
+kmem_cache_free (struct kmem_cache *c, void *obj) {
+	struct slab *s;
+	enum intr_level old_level;
+
+	if (obj == NULL)
+		return;
+
+	s = obj_to_slab (obj);
+	ASSERT (s->cache == c);
+
+	old_level = intr_disable ();
+	*obj_link (c, obj) = s->free_list;
+	s->free_list = obj;
+	if (s->free_cnt++ == 0) {
+		list_remove (&s->elem);
+		list_push_front (&c->partial, &s->elem);
+	}
+	c->active--;
+
+	/* 다음 할당을 위해 빈 슬랩 하나는 남겨 둡니다. */
+	if (s->free_cnt == c->objs_per_slab && c->slab_cnt > 1) {
+		list_remove (&s->elem);
+		c->slab_cnt--;
+		intr_set_level (old_level);
+		s->magic = 0;
+		palloc_free_page (s);
+		return;
+	}
+	intr_set_level (old_level);
+}
+
+/* 모든 캐시의 통계를 출력합니다. */
+void
+kmem_cache_print_stats (void) {
+	size_t i;
+
+	for (i = 0; i < cache_cnt; i++) {
+		struct kmem_cache *c = &caches[i];
+		printf ("Slab %s: %zu active objects, %zu slabs, %zu/%zu hits (%zu%%)\n",
+				c->name, c->active, c->slab_cnt, c->hit_cnt, c->alloc_cnt,
+				c->alloc_cnt ? c->hit_cnt * 100 / c->alloc_cnt : 100);
+	}
+}
+
+/* 캐시 C를 위한 새 슬랩을 만들고 모든 칸을 빈 칸 리스트에 넣습니다. */
+static struct slab *
+slab_create (struct kmem_cache *c) {
+	struct slab *s = palloc_get_page (0);
+	uint8_t *base;
+	size_t i;
+
+	if (s == NULL)
+		return NULL;
+
+	s->magic = SLAB_MAGIC;
+	s->cache = c;
+	s->free_cnt = c->objs_per_slab;
+	s->free_list = NULL;
+
+	base = (uint8_t *) s + ROUND_UP (sizeof (struct slab), 8);
+	for (i = c->objs_per_slab; i-- > 0; ) {
+		void *obj = base + i * c->obj_size;
+		if (c->ctor != NULL)
+			c->ctor (obj);
+		*obj_link (c, obj) = s->free_list;
+		s->free_list = obj;
+	}
+	return s;
+}
+
+/* OBJ가 들어 있는 슬랩을 반환합니다. */
+static struct slab *
+obj_to_slab (void *obj) {
+	struct slab *s = pg_round_down (obj);
+
+	ASSERT (s->magic == SLAB_MAGIC);
+	ASSERT ((uint8_t *) obj >= (uint8_t *) s + sizeof *s);
+	return s;
+}
+
+/* 빈 칸 OBJ에서 다음 빈 칸을 가리키는 포인터의 위치를 반환합니다. */
+static void **
+obj_link (struct kmem_cache *c, void *obj) {
+	return (void **) ((uint8_t *) obj + c->link_ofs);
+}
@@ -30,6 +30,7 @@
 #include <stdio.h>
 #include <string.h>
 #include "threads/interrupt.h"
+#include "threads/slab.h"
 #include "threads/thread.h"
 
 static bool compare_priority(const struct list_elem *a, const struct list_elem *b, void *aux);
@@ -43,6 +44,9 @@ static void recalc_priority();
 
 int idx = 0;
 
+/* donation 객체용 캐시. 처음 기부가 일어날 때 만듭니다. */
+static struct kmem_cache *donation_cache;
+
 static bool compare_priority(const struct list_elem *a, const struct list_elem *b, void *aux)
 {
 	struct thread *t1 = list_entry(a, struct thread, elem);
@@ -133,6 +137,13 @@ void sema_up(struct semaphore *sema)
 	old_level = intr_disable();
 	if (!list_empty(&sema->waiters))
 	{
+		// MLFQS는 잠든 스레드의 우선순위를 틱마다 계산하지 않으므로 고르기 전에 맞춥니다
+		if (thread_mlfqs)
+		{
+			struct list_elem *e;
+			for (e = list_begin(&sema->waiters); e != list_end(&sema->waiters); e = list_next(e))
+				update_priority(list_entry(e, struct thread, elem));
+		}
 		list_sort(&sema->waiters, compare_priority, NULL);		  // 먼저 정렬 -> 굳이 해야하나 싶다
 		thread_unblock(list_entry(list_pop_front(&sema->waiters), // 쓰레드 웨이트 리스트에 있는 쓰레드 하나 깨움
 								  struct thread, elem));
@@ -230,7 +241,7 @@ void lock_acquire(struct lock *lock)
 
 		if (holder->priority < thread_get_priority()) // 홀더의 우선순위 갱신
 		{
-			holder->priority = thread_get_priority();
+			thread_change_priority(holder, thread_get_priority());
 		}
 
 		list_insert_ordered(&holder->donations, &donate->elem, compare_priority_for_donate, NULL);
@@ -250,12 +261,17 @@ void lock_acquire(struct lock *lock)
 static donation *create_donation(struct thread *thread, struct lock *lock)
 {
 	struct lock *pending_lock = thread->pending_lock;
-	donation *donate = malloc(sizeof(donation)); // 기부자 목록도 유지해야함 !!
+	donation *donate;
+	enum intr_level old_level = intr_disable();
+	if (donation_cache == NULL)
+		donation_cache = kmem_cache_create("donation", sizeof(donation), NULL);
+	intr_set_level(old_level);
+	donate = kmem_cache_alloc(donation_cache); // 기부자 목록도 유지해야함 !!
+	ASSERT(donate != NULL);
 	thread->pending_lock = pending_lock;
 	donate->priority = thread_get_priority(); // 기부받은 우선순위 저장 -> 복구를 위해서
 	donate->donor = thread;					  // 기부자 저장
 	donate->lock = lock;					  // 락 저장
-	ASSERT(donate != NULL);
 	return donate;
 }
 
@@ -303,13 +319,16 @@ static void remove_donation_for_lock(struct lock *lock)
 	struct list_elem *e;
 	struct thread *cur = thread_current();
 
-	for (e = list_begin(&cur->donations); e != list_end(&cur->donations); e = list_next(e))
+	for (e = list_begin(&cur->donations); e != list_end(&cur->donations);)
 	{
 		donation *d = list_entry(e, donation, elem);
 		if (d->lock == lock)
 		{
-			list_remove(&d->elem);
+			e = list_remove(&d->elem);
+			kmem_cache_free(donation_cache, d); // 다 쓴 기부 기록은 캐시에 반환
 		}
+		else
+			e = list_next(e);
 	}
 }
 
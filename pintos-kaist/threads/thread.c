@@ -27,7 +27,13 @@
 
 /* List of processes in THREAD_READY state, that is, processes
    that are ready to run but not actually running. */
-static struct list ready_list;
+/* 우선순위마다 FIFO 큐를 하나씩 두고, ready_bitmap의 비트 P로 ready_queue[P]가 비어 있지 않음을 표시합니다.
+ * 가장 높은 우선순위는 비트맵의 최상위 비트(bsr)이므로 넣기, 빼기, 다음 스레드 고르기가 모두 O(1)입니다.
+ * 모두 인터럽트를 끈 상태에서만 건드립니다. */
+static struct list ready_queue[PRI_MAX + 1];
+static uint64_t ready_bitmap;
+static size_t ready_cnt; /* ready 상태인 스레드 수 */
+_Static_assert(PRI_MAX < 64, "ready_bitmap holds one bit per priority");
 
 /* Idle thread. */
 static struct thread *idle_thread;
@@ -65,6 +71,9 @@ static void do_schedule(int status);
 static void schedule(void);
 static tid_t allocate_tid(void);
 static bool compare_priority(const struct list_elem *a, const struct list_elem *b, void *aux);
+static void ready_push(struct thread *t);
+static void ready_remove(struct thread *t);
+static int ready_max_priority(void);
 
 /* Returns true if T appears to point to a valid thread. */
 #define is_thread(t) ((t) != NULL && (t)->magic == THREAD_MAGIC)
@@ -85,6 +94,17 @@ static uint64_t gdt[3] = {0,
 
 fixed_t load_avg = 0;
 
+/* MLFQS recent_cpu의 지연 감쇠
+ * 매초 모든 스레드의 recent_cpu를 감쇠시키는 대신, 그 초의 감쇠 계수만 decay_hist에 남기고
+ * 각 스레드는 recent_cpu를 마지막으로 맞춘 초(rc_sec)를 기억합니다. recent_cpu가 필요할 때
+ * recent_cpu_sync()가 밀린 계수를 차례로 적용하므로 원래 식과 같은 값이 나옵니다.
+ * RC_HISTORY초보다 오래 밀린 감쇠는 버립니다. 그만큼 지나면 recent_cpu는 이미 거의 수렴해 있습니다. */
+#define RC_HISTORY 256
+static fixed_t decay_hist[RC_HISTORY];
+static int64_t mlfqs_sec; /* 지금까지 지난 초 수 */
+static void recent_cpu_sync(struct thread *t);
+static void mlfqs_refresh_ready(void);
+
 /* Initializes the threading system by transforming the code
    that's currently running into a thread.  This can't work in
    general and it is possible in this case only because loader.S
@@ -112,7 +132,10 @@ void thread_init(void)
 
 	/* Init the globla thread context */
 	lock_init(&tid_lock);
-	list_init(&ready_list);
+	for (int i = PRI_MIN; i <= PRI_MAX; i++)
+		list_init(&ready_queue[i]);
+	ready_bitmap = 0;
+	ready_cnt = 0;
 	list_init(&destruction_req);
 	list_init(&all_list);
 
@@ -165,6 +188,12 @@ void thread_tick(void)
 		intr_yield_on_return();
 }
 
+/* tickless idle로 타이머 인터럽트 없이 지나간 틱 N개를 idle 시간으로 셉니다. */
+void thread_idle_ticks(int64_t n)
+{
+	idle_ticks += n;
+}
+
 /* Prints thread statistics. */
 void thread_print_stats(void)
 {
@@ -239,11 +268,29 @@ tid_t thread_create(const char *name, int priority,
 	return tid;
 }
 
-/* 인자로 받은 스레드의 recent_cpu를 수정하는 함수입니다.
-모든 스레드 업데이트에서 사용하기 위해 인자를 void를 thread로 수정했습니다 */
+/* 실행 중인 스레드의 recent_cpu를 1 올립니다. 밀린 감쇠를 먼저 적용해야 원래 식과 순서가 같습니다. */
 void update_recent_cpu(void)
 {
-	thread_current()->recent_cpu = add_fp_int(thread_current()->recent_cpu, 1);
+	struct thread *cur = thread_current();
+
+	if (cur == idle_thread)
+		return;
+	recent_cpu_sync(cur);
+	cur->recent_cpu = add_fp_int(cur->recent_cpu, 1);
+}
+
+/* T의 recent_cpu에 rc_sec 이후 밀린 초의 감쇠를 적용합니다.
+recent_cpu = (2 * load_avg) / (2 * load_avg + 1) * recent_cpu + nice */
+static void recent_cpu_sync(struct thread *t)
+{
+	int64_t from = t->rc_sec;
+
+	if (mlfqs_sec - from > RC_HISTORY)
+		from = mlfqs_sec - RC_HISTORY;
+	for (int64_t s = from; s < mlfqs_sec; s++)
+		t->recent_cpu = add_fp(mul_fp(decay_hist[s % RC_HISTORY], t->recent_cpu),
+							   int_to_fp(t->nice));
+	t->rc_sec = mlfqs_sec;
 }
 
 /* load_avg를 계산하는 함수입니다. mlfqs_on_tick에서 1초마다 호출되어야 합니다
@@ -252,7 +299,7 @@ load_avg = (59/60) * load_avg + (1/60) * ready_threads_size
 */
 void update_load_avg(void)
 {
-	int ready_threads = list_size(&ready_list);
+	int ready_threads = ready_cnt;
 	if (thread_current() != idle_thread)
 		ready_threads++;
 
@@ -263,12 +310,14 @@ void update_load_avg(void)
 }
 
 /* 인자로 받은 스레드의 우선순위를 계산하는 함수입니다.
-모든 스레드 업데이트에서 사용하기위해 인자를 void 에서 thread로 수정했습니다 */
+ready 큐에 있는 스레드면 새 우선순위의 큐로 옮깁니다 */
 void update_priority(struct thread *thread) // 4틱마다 계산
 {
 	if (thread == idle_thread)
 		return;
 
+	recent_cpu_sync(thread);
+
 	int new_priority = PRI_MAX - fp_to_int_round(div_fp_int(thread->recent_cpu, 4)) - (thread->nice * 2);
 
 	// Clamp to [PRI_MIN, PRI_MAX]
@@ -277,47 +326,35 @@ void update_priority(struct thread *thread) // 4틱마다 계산
 	if (new_priority < PRI_MIN)
 		new_priority = PRI_MIN;
 
-	thread->priority = new_priority;
+	thread_change_priority(thread, new_priority);
 }
 
-/* 모든 스레드의 CPU 점유율을 계산하는 함수입니다.
-mlfqs_on_tick에서 사용되어야 합니다 */
+/* 1초가 지날 때 부르는 함수입니다. 이번 초의 감쇠 계수를 남기고 초를 넘깁니다.
+스레드들의 recent_cpu는 건드리지 않고, 우선순위가 바로 필요한 ready 스레드만 다시 계산합니다.
+blocked 스레드는 thread_unblock()에서 깨어날 때 계산합니다 */
 void update_recent_cpu_all(void)
 {
-	/* TODO :
-	recent_cpu = (2 * load_avg) / (2 * load_avg + 1) * recent_cpu + nice
-	와 같은 계산식을 사용하여 CPU 점유율을 다시 계산해야 합니다
-	*/
-	struct list_elem *e;
-	for (e = list_begin(&all_list); e != list_end(&all_list); e = list_next(e))
-	{
-		struct thread *entry = list_entry(e, struct thread, all_elem);
-		if (entry->status == THREAD_DYING || entry == idle_thread)
-			continue;
-		fixed_t coeff = div_fp(
-			mul_fp_int(load_avg, 2),
-			add_fp_int(mul_fp_int(load_avg, 2), 1));
-
-		entry->recent_cpu = add_fp(
-			mul_fp(coeff, entry->recent_cpu),
-			int_to_fp(entry->nice));
-	}
+	decay_hist[mlfqs_sec % RC_HISTORY] = div_fp(
+		mul_fp_int(load_avg, 2),
+		add_fp_int(mul_fp_int(load_avg, 2), 1));
+	mlfqs_sec++;
+	mlfqs_refresh_ready();
 }
 
-/* 모든 스레드의 우선순위를 계산하는 함수입니다.
-mlfqs_on_tick에서 사용되어야 합니다 */
-void update_all_priority(void)
+/* ready 큐에 있는 모든 스레드의 우선순위를 다시 계산합니다. 1초에 한 번만 부릅니다.
+낮은 큐로 옮겨진 스레드를 다시 만날 수 있지만, 다시 계산해도 결과가 같습니다 */
+static void mlfqs_refresh_ready(void)
 {
-	// TODO : 모든 리스트 순회하며 update_priority 호출
-	struct list_elem *e;
-	for (e = list_begin(&all_list); e != list_end(&all_list); e = list_next(e))
+	for (int pri = PRI_MAX; pri >= PRI_MIN; pri--)
 	{
-		struct thread *entry = list_entry(e, struct thread, all_elem);
-		if (entry->status == THREAD_DYING || entry == idle_thread)
-			continue;
-		update_priority(entry);
+		struct list_elem *e = list_begin(&ready_queue[pri]);
+		while (e != list_end(&ready_queue[pri]))
+		{
+			struct thread *t = list_entry(e, struct thread, elem);
+			e = list_next(e);
+			update_priority(t);
+		}
 	}
-	compare_cur_next_priority();
 }
 
 /* Puts the current thread to sleep.  It will not be scheduled
@@ -351,7 +388,13 @@ void thread_unblock(struct thread *t)
 	old_level = intr_disable(); // 인터럽트 끄기 -> 레이스 컨디션 방지
 	ASSERT(t->status == THREAD_BLOCKED);
 
-	list_insert_ordered(&ready_list, &t->elem, compare_priority, NULL); // 우선순위 순으로 레디 큐에 저장
+	// idle이 타이머를 one-shot으로 걸어 두었다면 실행할 스레드가 생겼으니 주기 모드로 되돌림
+	timer_idle_exit();
+
+	// 자는 동안 밀린 recent_cpu 감쇠를 적용하고 우선순위를 다시 계산
+	if (thread_mlfqs)
+		update_priority(t);
+	ready_push(t); // 우선순위에 해당하는 레디 큐에 저장
 	t->status = THREAD_READY;
 
 	intr_set_level(old_level); // 인터럽트 다시 켜기
@@ -365,6 +408,59 @@ static bool compare_priority(const struct list_elem *a, const struct list_elem *
 	return t1->priority > t2->priority;
 }
 
+/* T를 자기 우선순위 큐의 끝에 넣습니다. 인터럽트를 끈 상태에서 호출해야 합니다. */
+static void
+ready_push(struct thread *t)
+{
+	ASSERT(intr_get_level() == INTR_OFF);
+
+	list_push_back(&ready_queue[t->priority], &t->elem);
+	ready_bitmap |= 1ULL << t->priority;
+	ready_cnt++;
+}
+
+/* ready 큐에 있는 T를 뺍니다. 큐가 비면 비트맵의 비트도 끕니다. */
+static void
+ready_remove(struct thread *t)
+{
+	ASSERT(intr_get_level() == INTR_OFF);
+	ASSERT(t->status == THREAD_READY);
+
+	list_remove(&t->elem);
+	if (list_empty(&ready_queue[t->priority]))
+		ready_bitmap &= ~(1ULL << t->priority);
+	ready_cnt--;
+}
+
+/* ready 스레드 중 가장 높은 우선순위를 반환합니다. ready 큐가 비어 있으면 -1을 반환합니다. */
+static int
+ready_max_priority(void)
+{
+	uint64_t pri;
+
+	if (ready_bitmap == 0)
+		return -1;
+	__asm __volatile("bsrq %1, %0" : "=r"(pri) : "rm"(ready_bitmap));
+	return pri;
+}
+
+/* T의 우선순위를 PRIORITY로 바꿉니다. T가 ready 큐에 있으면 새 우선순위 큐의 끝으로 옮깁니다.
+ * 기부나 MLFQS 재계산처럼 다른 스레드의 우선순위를 바꿀 때는 이 함수를 써야 합니다. */
+void thread_change_priority(struct thread *t, int priority)
+{
+	enum intr_level old_level = intr_disable();
+
+	if (t->status == THREAD_READY && t->priority != priority)
+	{
+		ready_remove(t);
+		t->priority = priority;
+		ready_push(t);
+	}
+	else
+		t->priority = priority;
+	intr_set_level(old_level);
+}
+
 /* Returns the name of the running thread. */
 const char *
 thread_name(void)
@@ -439,17 +535,31 @@ void thread_yield(void)
 	struct thread *curr = thread_current();
 	enum intr_level old_level;
 	// dprintf("현재 실행 쓰레드 : %s\n", thread_name());
-	// dprintf("현재 레디 리스트 사이즈 : %d\n", list_size(&ready_list));
 
 	ASSERT(!intr_context());
 
 	old_level = intr_disable();
 	if (curr != idle_thread)
-		list_insert_ordered(&ready_list, &curr->elem, compare_priority, NULL);
+		ready_push(curr);
 	do_schedule(THREAD_READY);
 	intr_set_level(old_level);
 }
 
+/* Invoke function 'func' on all threads, passing along 'aux'.
+   This function must be called with interrupts off. */
+void thread_foreach(thread_action_func *func, void *aux)
+{
+	struct list_elem *e;
+
+	ASSERT(intr_get_level() == INTR_OFF);
+
+	for (e = list_begin(&all_list); e != list_end(&all_list); e = list_next(e))
+	{
+		struct thread *t = list_entry(e, struct thread, all_elem);
+		func(t, aux);
+	}
+}
+
 /* Sets the current thread's priority to NEW_PRIORITY. */
 void thread_set_priority(int new_priority)
 {
@@ -477,16 +587,10 @@ void thread_set_priority(int new_priority)
 	compare_cur_next_priority();
 }
 
+/* ready 큐에 현재 스레드보다 우선순위가 높은 스레드가 있으면 양보합니다. */
 void compare_cur_next_priority(void)
 {
-	if (list_empty(&ready_list))
-	{
-		return;
-	}
-
-	list_sort(&ready_list, compare_priority, NULL);
-	struct thread *next = list_entry(list_front(&ready_list), struct thread, elem);
-	if (next->priority > thread_current()->priority)
+	if (ready_max_priority() > thread_current()->priority)
 	{
 		if (intr_context())
 			intr_yield_on_return();
@@ -505,12 +609,15 @@ int thread_get_priority(void)
 void thread_set_nice(int nice UNUSED)
 {
 	struct thread *cur = thread_current();
+	enum intr_level old_level = intr_disable();
+	recent_cpu_sync(cur);
 	cur->nice = nice;
 
 	// nice값이 바뀌었으니 priority도 다시 계산함
 	update_priority(cur);
+	intr_set_level(old_level);
 
-	// 만약 ready_list에 더 높은 priority가 있으면 양보
+	// 만약 ready 큐에 더 높은 priority가 있으면 양보
 	compare_cur_next_priority();
 }
 
@@ -529,6 +636,9 @@ int thread_get_load_avg(void)
 /* Returns 100 times the current thread's recent_cpu value. */
 int thread_get_recent_cpu(void)
 {
+	enum intr_level old_level = intr_disable();
+	recent_cpu_sync(thread_current());
+	intr_set_level(old_level);
 	return fp_to_int_round(thread_current()->recent_cpu * 100);
 }
 
@@ -555,6 +665,9 @@ idle(void *idle_started_ UNUSED)
 		intr_disable();
 		thread_block();
 
+		/* 다음에 할 일이 있는 틱까지 주기 타이머 인터럽트를 멈춥니다. */
+		timer_idle_enter();
+
 		/* Re-enable interrupts and wait for the next one.
 
 		   The `sti' instruction disables interrupts until the
@@ -612,9 +725,11 @@ init_thread(struct thread *t, const char *name, int priority)
 		else if (t != initial_thread)
 		{
 			// 새로 생성되는 스레드는 부모(현재 스레드)의 값을 상속받음
+			recent_cpu_sync(thread_current());
 			t->nice = thread_current()->nice;
 			t->recent_cpu = thread_current()->recent_cpu;
 		}
+		t->rc_sec = mlfqs_sec;
 	}
 
 	list_init(&t->children_list);
@@ -632,10 +747,13 @@ init_thread(struct thread *t, const char *name, int priority)
 static struct thread *
 next_thread_to_run(void)
 {
-	if (list_empty(&ready_list))
+	int pri = ready_max_priority();
+	if (pri < 0)
 		return idle_thread;
-	else
-		return list_entry(list_pop_front(&ready_list), struct thread, elem);
+
+	struct thread *next = list_entry(list_front(&ready_queue[pri]), struct thread, elem);
+	ready_remove(next);
+	return next;
 }
 
 /* Use iretq to launch the thread */
@@ -748,6 +866,8 @@ do_schedule(int status)
 	{
 		struct thread *victim =
 			list_entry(list_pop_front(&destruction_req), struct thread, elem);
+		/* 해제한 페이지를 all_list로 다시 따라가지 않도록 여기서 뺍니다. */
+		list_remove(&victim->all_elem);
 		palloc_free_page(victim);
 	}
 	thread_current()->status = status;
@@ -6,6 +6,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include "userprog/gdt.h"
+#include "userprog/syscall.h"
 #include "userprog/tss.h"
 #include "filesys/directory.h"
 #include "filesys/file.h"
@@ -191,7 +192,14 @@ __do_fork(void *aux)
 	process_activate(current);
 #ifdef VM
 	supplemental_page_table_init(&current->spt);
-	if (!supplemental_page_table_copy(&current->spt, &parent->spt))
+	/* 부모는 fork가 끝날 때까지 멈춰 있으므로, 올라와 있는 부모 페이지를 먼저 한 번에 쓰기 금지해
+	 * copy-on-write로 공유할 준비를 합니다. dirty 비트는 그대로 남아 write-back 판단에 쓰입니다.
+	 * pageout 데몬과 교체도 rmap으로 부모의 PTE를 바꾸므로 복사가 끝날 때까지 frame_lock을 잡습니다. */
+	lock_acquire(&frame_table->frame_lock);
+	pml4_protect_range(parent->pml4, NULL, (void *)KERN_BASE, false);
+	succ = supplemental_page_table_copy(&current->spt, &parent->spt);
+	lock_release(&frame_table->frame_lock);
+	if (!succ)
 		goto error;
 #else
 	if (parent->pml4 == NULL)
@@ -342,6 +350,14 @@ static struct thread *get_my_child(tid_t tid)
 	return NULL;
 }
 
+/* 다른 스레드가 종료를 요청한(killed) 현재 프로세스를 exit(-1)로 끝냅니다.
+ * 인터럽트 핸들러의 끝에서도 부르므로 인터럽트를 켜고 종료합니다. */
+void process_kill(void)
+{
+	intr_enable();
+	sys_exit(-1);
+}
+
 /* 프로세스를 종료합니다. 이 함수는 thread_exit()에 의해 호출됩니다. */
 void process_exit(void)
 {
@@ -487,6 +503,7 @@ load(const char *file_name, struct intr_frame *if_)
 	off_t file_ofs;
 	bool success = false;
 	int i;
+	uint64_t image_end = 0; /* 적재한 세그먼트 중 가장 높은 끝 주소 */
 
 	char *argv[MAX_ARGS];
 	int argc = parse_args(file_name, argv);
@@ -577,6 +594,8 @@ load(const char *file_name, struct intr_frame *if_)
 				if (!load_segment(file, file_page, (void *)mem_page,
 								  read_bytes, zero_bytes, writable))
 					goto done;
+				if (mem_page + read_bytes + zero_bytes > image_end)
+					image_end = mem_page + read_bytes + zero_bytes;
 			}
 			else
 				goto done;
@@ -584,6 +603,11 @@ load(const char *file_name, struct intr_frame *if_)
 		}
 	}
 
+#ifdef VM
+	/* 힙(brk)은 실행 파일 이미지 바로 뒤에서 비어 있는 상태로 시작합니다. */
+	t->spt.heap_start = t->spt.heap_brk = (void *)image_end;
+#endif
+
 	/* 스택을 설정합니다. */
 	if (!setup_stack(if_))
 		goto done;
@@ -835,7 +859,7 @@ load_segment(struct file *file, off_t ofs, uint8_t *upage,
 		size_t page_zero_bytes = PGSIZE - page_read_bytes;					// 0 패딩 사이즈는 4KB - read_byte
 
 		/* TODO: Set up aux to pass information to the lazy_load_segment. */
-		struct file_info *aux= malloc(sizeof(struct file_info));
+		struct file_info *aux= kmem_cache_alloc(file_info_cachep);
 		if(aux==NULL) return false;
 
 		aux->file=file_reopen(file);
@@ -1,5 +1,6 @@
 #include "userprog/syscall.h"
 #include <stdio.h>
+#include <string.h>
 #include <syscall-nr.h>
 #include "threads/interrupt.h"
 #include "threads/thread.h"
@@ -34,6 +35,11 @@ int sys_wait(tid_t pid);
 int sys_dup2(int oldfd, int newfd);
 void *sys_mmap(void *addr, size_t length, int writable, int fd, off_t offset);
 void sys_munmap(void *addr);
+int sys_madvise(void *addr, size_t length, int advice);
+int sys_msync(void *addr, size_t length);
+void *sys_brk(void *addr);
+int sys_mem_notify(void);
+int64_t sys_clock_nanos(void);
 
 /* 시스템 콜.
  *
@@ -80,6 +86,8 @@ void syscall_handler(struct intr_frame *f UNUSED)
 	uint64_t arg6 = f->R.r9;
 	if (f->cs == SEL_UCSEG)
         thread_current()->user_rsp = f->rsp;
+	if (thread_current()->killed)
+		process_kill();
 	// syscall_handler 내부
 	switch (syscall_num)
 	{
@@ -134,10 +142,29 @@ void syscall_handler(struct intr_frame *f UNUSED)
 	case SYS_MUNMAP:
 		sys_munmap(arg1);
 		break;
+	case SYS_MADVISE:
+		f->R.rax = sys_madvise((void *)arg1, arg2, arg3);
+		break;
+	case SYS_MSYNC:
+		f->R.rax = sys_msync((void *)arg1, arg2);
+		break;
+	case SYS_BRK:
+		f->R.rax = (uint64_t)sys_brk((void *)arg1);
+		break;
+	case SYS_MEMNOTIFY:
+		f->R.rax = sys_mem_notify();
+		break;
+	case SYS_CLOCKNANOS:
+		f->R.rax = sys_clock_nanos();
+		break;
 	default:
 		thread_exit();
 		break;
 	}
+
+	/* 시스템 콜을 처리하는 동안 OOM 킬러에게 선택되었으면 유저 모드로 돌아가지 않습니다. */
+	if (thread_current()->killed)
+		process_kill();
 }
 
 // 주소값이 유저 영역(0x8048000~0xc0000000)에서 사용하는 주소값인지 확인하는 함수
@@ -189,6 +216,10 @@ void check_buffer(const void *buffer, unsigned size, bool write)
 				{
 					sys_exit(-1); // 쓰기 권한이 없으면 종료
 				}
+				/* copy-on-write나 KSM으로 공유 중인 페이지는 미리 복사해 둡니다. 내용은 file_io_bounce()가
+				 * filesys_lock 밖에서 채우지만, 버퍼 검사 단계에서 메모리 부족을 먼저 알 수 있습니다. */
+				if (!is_writable(pte) && !vm_try_handle_fault(NULL, addr, true, true, false))
+					sys_exit(-1);
 			}
 		}
 	}
@@ -202,24 +233,61 @@ void sys_munmap(void *addr)
 	 * 3. 매핑 카운트나 page 구조체 내의 카운트를 사용해서 제거
 	 */
 
-	struct thread *thread = thread_current(); 
-	struct page * page=spt_find_page(&thread->spt, addr);
+	/* ADDR에서 시작하는 VMA를 통째로 해제합니다. */
+	do_munmap(addr);
 
-	struct file_info *aux = (struct file_info *)page->file.aux;
-	size_t target_length = aux->mmap_length;
+}
 
-	void *start_addr = addr;
-	void *cur_addr = addr;
-	void *end_addr = addr + target_length;
+/* [ADDR, ADDR + LENGTH)가 페이지 정렬된 사용자 주소 구간이면 true를 반환합니다. */
+static bool
+check_map_range(void *addr, size_t length)
+{
+	if (addr == NULL || pg_ofs(addr) != 0 || !is_user_vaddr(addr))
+		return false;
+	return length == 0 || (addr + length > addr && is_user_vaddr(addr + length - 1));
+}
 
-	for (cur_addr = start_addr; cur_addr < end_addr; cur_addr += PGSIZE) {
-		do_munmap(cur_addr);
-    }
+/* ADDR부터 LENGTH 바이트의 mmap 구간에 대한 접근 패턴(MADV_*)을 알려 줍니다.
+ * 성공하면 0, 구간이 mmap 밖이거나 ADVICE가 잘못되면 -1을 반환합니다. */
+int sys_madvise(void *addr, size_t length, int advice)
+{
+	if (!check_map_range(addr, length))
+		return -1;
+	return do_madvise(addr, length, advice);
+}
 
+/* ADDR부터 LENGTH 바이트의 mmap 구간에서 바뀐 내용을 파일에 바로 반영합니다.
+ * 성공하면 0, 구간이 mmap 밖이면 -1을 반환합니다. */
+int sys_msync(void *addr, size_t length)
+{
+	if (!check_map_range(addr, length))
+		return -1;
+	return do_msync(addr, length);
+}
+
+/* 힙의 끝을 ADDR로 옮기고 옮긴 뒤의 끝을 반환합니다. ADDR이 NULL이면 현재 끝만 알려 줍니다. */
+void *sys_brk(void *addr)
+{
+	return vm_brk(addr);
+}
+
+/* 다음번에 메모리가 부족해질 때까지 기다렸다가 그때의 빈 유저 페이지 수를 반환합니다.
+ * 협조하는 프로그램은 깨어나면 캐시 같은 버려도 되는 메모리를 munmap이나 madvise로 돌려줍니다. */
+int sys_mem_notify(void)
+{
+	return vm_mem_notify();
+}
+
+/* 부팅 뒤 흐른 시간을 나노초로 반환합니다. TSC 기반이라 틱보다 훨씬 잘게 잴 수 있습니다. */
+int64_t sys_clock_nanos(void)
+{
+	return timer_nanos();
 }
 
 /*
 매핑 성공시 매핑된 가상 주소 addr을 반환, 실패시 NULL 반환 
+fd가 MAP_ANON(-1)이면 0으로 채워진 익명 매핑을 만들고,
+writable에 MAP_POPULATE를 함께 주면 모든 페이지를 미리 올려 둡니다.
 */
 void *sys_mmap(void *addr, size_t length, int writable, int fd, off_t offset)
 {
@@ -227,49 +295,52 @@ void *sys_mmap(void *addr, size_t length, int writable, int fd, off_t offset)
     if (addr == NULL || !is_user_vaddr(addr) || (uint64_t)addr == 0 || (uint64_t)addr % PGSIZE != 0)
         return MAP_FAILED;
 
-    // fd가 0, 1(콘솔)이거나 음수거나 MAX_FD 넘어가면 실패
-    if (fd == 0 || fd == 1 || fd < 0 || fd >= MAX_FD)
-        return MAP_FAILED;
+    bool populate = (writable & MAP_POPULATE) != 0;
+    writable &= ~MAP_POPULATE;
 
-    // 파일 포인터 확인
-    struct file *file = thread_current()->fd_table[fd];
-    if (file == NULL || file->inode == NULL)
-        return MAP_FAILED;
+    // 익명 매핑은 파일 없이 길이만 검사
+    struct file *file = NULL;
+    if (fd == MAP_ANON)
+    {
+        if (length == 0 || offset != 0)
+            return MAP_FAILED;
+    }
+    else
+    {
+        // fd가 0, 1(콘솔)이거나 음수거나 MAX_FD 넘어가면 실패
+        if (fd == 0 || fd == 1 || fd < 0 || fd >= MAX_FD)
+            return MAP_FAILED;
 
-    // offset은 반드시 페이지 정렬
-    if (offset % PGSIZE != 0)
-        return MAP_FAILED;
+        // 파일 포인터 확인
+        file = thread_current()->fd_table[fd];
+        if (file == NULL || file->inode == NULL)
+            return MAP_FAILED;
 
-    // 파일 사이즈, length 검사 (이제 file은 NULL 아님이 보장됨)
-    int filesize = sys_filesize(fd); 
-    if (filesize == 0 || length == 0 || length > (uintptr_t)addr)
-        return MAP_FAILED;
+        // offset은 반드시 페이지 정렬
+        if (offset % PGSIZE != 0)
+            return MAP_FAILED;
 
-    // 매핑하려는 주소 영역 중복 검사
-    void *end_page = addr + length;
-    for (void *page = addr; page < end_page; page += PGSIZE)
-    {
-        if (spt_find_page(&thread_current()->spt, page) != NULL)
+        // 파일 사이즈, length 검사 (이제 file은 NULL 아님이 보장됨)
+        int filesize = sys_filesize(fd); 
+        if (filesize == 0 || length == 0 || length > (uintptr_t)addr)
             return MAP_FAILED;
     }
 
+    // 매핑하려는 주소 영역 중복 검사 (다른 mmap 구간, 이미 있는 페이지)
+    struct supplemental_page_table *spt = &thread_current()->spt;
+    void *end_page = pg_round_up(addr + length);
+	if (end_page < addr || !is_user_vaddr(end_page - 1) || vma_overlaps(spt, addr, end_page) ||
+		spt_range_used(spt, addr, end_page))
+		return MAP_FAILED;
+
 	/* 파일 디스크립터 fd 로 열린 파일의 offset 바이트부터 length 바이트만큼 
-	프로세스의 가상 주소 공간의 addr 부터 매핑한다. 매핑은 페이지 단위로 이루어짐
+	프로세스의 가상 주소 공간의 addr 부터 매핑한다. 매핑 전체를 VMA 하나로 기록하고
+	페이지는 접근할 때 만든다.
 	*/
-	size_t remain_length = length;
-	void *cur_addr = addr;
-	off_t cur_offset = offset;
-
-	while (remain_length > 0)
-	{	
-		size_t allocate_length = remain_length > PGSIZE ? PGSIZE : remain_length;
-		if(do_mmap(cur_addr, allocate_length, writable, thread_current()->fd_table[fd], cur_offset, length)==NULL)
-			return MAP_FAILED;
-		if(remain_length<allocate_length) break;
-		remain_length -= allocate_length;
-		cur_addr += allocate_length;
-		cur_offset += allocate_length;
-	}
+	if (do_mmap(addr, length, writable, file, offset) == NULL)
+		return MAP_FAILED;
+	if (populate)
+		vm_populate(addr, end_page);
 
 	return addr;
 }
@@ -311,6 +382,39 @@ void sys_halt()
 	power_off();
 }
 
+/* FILE과 유저 BUFFER 사이에서 SIZE 바이트를 커널 페이지 하나를 거쳐 PGSIZE씩 옮깁니다. WRITE면 파일에 씁니다.
+ * filesys_lock을 쥔 동안에는 커널 페이지만 건드립니다. 그 사이 유저 버퍼에서 폴트가 나면 frame_lock을 기다리는데,
+ * 교체 중인 스레드는 write-back을 위해 filesys_lock을 기다리므로 서로 멈출 수 있습니다.
+ * 옮긴 바이트 수를 반환하고, 커널 페이지를 얻지 못하면 -1을 반환합니다. */
+static int
+file_io_bounce(struct file *file, void *buffer, unsigned size, bool write)
+{
+	uint8_t *kbuf = palloc_get_page(0);
+	if (kbuf == NULL)
+		return -1;
+
+	unsigned done = 0;
+	while (done < size)
+	{
+		unsigned chunk = size - done < PGSIZE ? size - done : PGSIZE;
+		off_t n;
+
+		if (write)
+			memcpy(kbuf, (uint8_t *)buffer + done, chunk);
+		lock_acquire(&filesys_lock);
+		n = write ? file_write(file, kbuf, chunk) : file_read(file, kbuf, chunk);
+		lock_release(&filesys_lock);
+		if (!write)
+			memcpy((uint8_t *)buffer + done, kbuf, n);
+
+		done += n;
+		if ((unsigned)n < chunk)
+			break;
+	}
+	palloc_free_page(kbuf);
+	return done;
+}
+
 static int sys_write(int fd, const void *buffer, unsigned size)
 {
 	int i=0;
@@ -330,10 +434,7 @@ static int sys_write(int fd, const void *buffer, unsigned size)
 	if (f == NULL)
 		return -1;
 
-	lock_acquire(&filesys_lock);
-	int bytes_written = file_write(f, buffer, size);
-	lock_release(&filesys_lock);
-	return bytes_written;
+	return file_io_bounce(f, (void *)buffer, size, true);
 }
 
 void sys_exit(int status)
@@ -425,10 +526,7 @@ int sys_read(int fd, void *buffer, unsigned size)
 	}
 
 	// 파일 읽기
-	lock_acquire(&filesys_lock);
-	int bytes_read = file_read(file_obj, buffer, size);
-	lock_release(&filesys_lock);
-	return bytes_read;
+	return file_io_bounce(file_obj, buffer, size, false);
 }
 
 int find_unused_fd(const char *file)
@@ -1,10 +1,15 @@
 /* anon.c: Implementation of page for non-disk image (a.k.a. anonymous page). */
 
+#include <string.h>
 #include "vm/vm.h"
 #include "threads/vaddr.h"
+#include "userprog/process.h"
 #include "lib/kernel/bitmap.h"
 #include "devices/disk.h"
 #include "threads/mmu.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "vm/zswap.h"
 
 /* DO NOT MODIFY BELOW LINE */
 static struct disk *swap_disk;
@@ -14,6 +19,25 @@ static void anon_destroy(struct page *page);
 
 struct bitmap *swap_table;
 
+/* fork로 공유된 스왑 슬롯을 위해 슬롯마다 참조하는 페이지 수를 셉니다.
+ * swap_lock이 swap_table과 swap_refs를 함께 보호합니다. */
+static uint16_t *swap_refs;
+static struct lock swap_lock;
+
+/* 스왑 슬롯 배치 (swap_lock으로 보호)
+ * 슬롯마다 어떤 가상 주소의 내용인지 기록해 두고(swap_va), 스왑 인 readahead가 이웃 슬롯을 찾을 때 씁니다.
+ * 새 슬롯은 swap_cursor부터 빈 클러스터를 찾고(next-fit), 직전에 내보낸 페이지의
+ * 바로 다음 가상 페이지라면 직전 슬롯 바로 뒤에 이어 붙입니다. */
+#define SWAP_CLUSTER 8
+static void **swap_va;
+static size_t swap_cursor;
+static struct thread *last_owner;
+static void *last_va;
+static size_t last_slot;
+
+static size_t swap_slot_alloc(struct page *page);
+static void swap_slot_release(struct page *page);
+
 /* DO NOT MODIFY this struct */
 static const struct page_operations anon_ops = {
 	.swap_in = anon_swap_in,
@@ -32,7 +56,100 @@ void vm_anon_init(void)
 	 * 스왑 테이블 엔트리에 이 엔트리가 비어있다는 비트 필요
 	 * bitmap 공부가 필요할듯
 	 */
-	swap_table = bitmap_create(disk_size(swap_disk) / (PGSIZE / DISK_SECTOR_SIZE));
+	size_t slot_cnt = disk_size(swap_disk) / (PGSIZE / DISK_SECTOR_SIZE);
+	swap_table = bitmap_create(slot_cnt);
+	swap_refs = calloc(slot_cnt, sizeof *swap_refs);
+	swap_va = calloc(slot_cnt, sizeof *swap_va);
+	ASSERT(swap_table != NULL && swap_refs != NULL && swap_va != NULL);
+	lock_init(&swap_lock);
+	zswap_init(swap_disk, slot_cnt);
+	swap_cursor = 0;
+	last_owner = NULL;
+	last_slot = BITMAP_ERROR;
+}
+
+/* PAGE를 내보낼 빈 슬롯을 골라 사용 중으로 표시합니다. 없으면 BITMAP_ERROR를 반환합니다. */
+static size_t
+swap_slot_alloc(struct page *page)
+{
+	size_t slot_cnt = bitmap_size(swap_table);
+	size_t slot = BITMAP_ERROR;
+
+	lock_acquire(&swap_lock);
+	/* 가상 주소가 이어지는 페이지는 슬롯도 이어지게 */
+	if (page->owner == last_owner && page->va == last_va + PGSIZE &&
+		last_slot + 1 < slot_cnt && !bitmap_test(swap_table, last_slot + 1))
+		slot = last_slot + 1;
+
+	/* 아니면 cursor부터 통째로 빈 클러스터를 찾아 새로 시작하고, 없으면 아무 빈 슬롯이나 씁니다 */
+	if (slot == BITMAP_ERROR)
+		slot = bitmap_scan(swap_table, swap_cursor, SWAP_CLUSTER, false);
+	if (slot == BITMAP_ERROR)
+		slot = bitmap_scan(swap_table, 0, SWAP_CLUSTER, false);
+	if (slot == BITMAP_ERROR)
+		slot = bitmap_scan(swap_table, swap_cursor, 1, false);
+	if (slot == BITMAP_ERROR)
+		slot = bitmap_scan(swap_table, 0, 1, false);
+
+	if (slot != BITMAP_ERROR)
+	{
+		bitmap_mark(swap_table, slot);
+		swap_refs[slot] = 1;
+		page->owner->spt.swap_cnt++;
+		swap_va[slot] = page->va;
+		swap_cursor = slot + 1;
+		last_owner = page->owner;
+		last_va = page->va;
+		last_slot = slot;
+	}
+	lock_release(&swap_lock);
+	return slot;
+}
+
+/* SLOT이 사용 중이면 그 슬롯에 담긴 페이지의 가상 주소를, 아니면 NULL을 반환합니다. */
+void *
+anon_swap_slot_va(size_t slot)
+{
+	void *va = NULL;
+
+	lock_acquire(&swap_lock);
+	if (slot < bitmap_size(swap_table) && bitmap_test(swap_table, slot))
+		va = swap_va[slot];
+	lock_release(&swap_lock);
+	return va;
+}
+
+/* PAGE가 가리키는 스왑 슬롯 참조를 하나 놓고, 마지막 참조였다면 슬롯을 비웁니다. */
+static void
+swap_slot_release(struct page *page)
+{
+	int swap_idx = page->anon.swap_idx;
+
+	lock_acquire(&swap_lock);
+	ASSERT(swap_refs[swap_idx] > 0);
+	page->owner->spt.swap_cnt--;
+	if (--swap_refs[swap_idx] == 0)
+	{
+		/* 슬롯이 다시 할당되기 전에 압축 캐시의 옛 내용을 버립니다. */
+		zswap_invalidate(swap_idx);
+		bitmap_set(swap_table, swap_idx, false);
+	}
+	lock_release(&swap_lock);
+}
+
+/* fork 시 스왑 아웃된 SRC의 슬롯을 DST도 가리키게 합니다.
+ * 먼저 스왑 인하는 쪽은 자기 프레임으로 읽어 가고 슬롯은 남은 쪽이 계속 씁니다. */
+void
+anon_swap_share(struct page *dst, struct page *src)
+{
+	int swap_idx = src->anon.swap_idx;
+	ASSERT(swap_idx != -1);
+
+	lock_acquire(&swap_lock);
+	swap_refs[swap_idx]++;
+	dst->owner->spt.swap_cnt++;
+	lock_release(&swap_lock);
+	dst->anon.swap_idx = swap_idx;
 }
 
 /* Initialize the file mapping */
@@ -46,8 +163,38 @@ bool anon_initializer(struct page *page, enum vm_type type, void *kva)
 
 	struct anon_page *anon_page = &page->anon;
 	anon_page->swap_idx = -1;
-	
+	anon_page->backing = NULL;
+
+	return true;
+}
+
+/* 내용이 바뀌어 더는 실행 파일과 같지 않은 PAGE의 원본 정보를 버립니다. */
+void
+anon_drop_backing(struct page *page)
+{
+	struct file_info *info = page->anon.backing;
+
+	if (info != NULL)
+	{
+		page->anon.backing = NULL;
+		file_close(info->file);
+		kmem_cache_free(file_info_cachep, info);
+	}
+}
+
+/* 버렸던 페이지를 INFO가 가리키는 실행 파일 위치에서 KVA로 다시 읽습니다. */
+static bool
+anon_refetch(struct file_info *info, void *kva)
+{
+	size_t read_bytes = info->read_bytes < PGSIZE ? info->read_bytes : PGSIZE;
 
+	lock_acquire(&filesys_lock);
+	off_t bytes_read = file_read_at(info->file, kva, read_bytes, info->ofs);
+	lock_release(&filesys_lock);
+
+	if (bytes_read < 0)
+		return false;
+	memset(kva + bytes_read, 0, PGSIZE - bytes_read);
 	return true;
 }
 
@@ -65,14 +212,19 @@ anon_swap_in(struct page *page, void *kva)
 	struct anon_page *anon_page = &page->anon;
 	int swap_idx = anon_page->swap_idx;
 	if(swap_idx !=-1){
-		for(int i=0; i<8; i++){
-			disk_read(swap_disk, (swap_idx * 8 )+ i , kva + (i * DISK_SECTOR_SIZE));
-		}
-		
-		bitmap_set(swap_table, swap_idx, false);
+		/* 압축 캐시에 있으면 디스크를 읽지 않습니다. */
+		if (!zswap_load(swap_idx, kva))
+			for(int i=0; i<8; i++){
+				disk_read(swap_disk, (swap_idx * 8 )+ i , kva + (i * DISK_SECTOR_SIZE));
+			}
+
+		swap_slot_release(page);
 		anon_page->swap_idx = -1;
 		return true;
 	}
+	/* 깨끗한 채로 버려진 실행 파일 페이지 */
+	if (anon_page->backing != NULL)
+		return anon_refetch(anon_page->backing, kva);
 	return false;
 
 }
@@ -94,22 +246,18 @@ anon_swap_out(struct page *page)
 	struct anon_page *anon_page = &page->anon;
 	struct frame *frame = page->frame;
 
-	int table_idx = bitmap_scan_and_flip(swap_table, 0, 1, 0);
+	size_t table_idx = swap_slot_alloc(page);
 	if (table_idx == BITMAP_ERROR)
-	{
-		ASSERT(bitmap_test(swap_table, table_idx) == false);
 		return false;
-	}
-
 
-	for(int i=0; i<8; i++){
-		disk_write(swap_disk, (table_idx * 8) + i, frame->kva + (DISK_SECTOR_SIZE * i));
-	}
 
-	frame->r_cnt--;
-	page->frame->page = NULL;
-	page->frame = NULL;
+	/* 먼저 압축 캐시에 넣어 보고, 잘 줄지 않는 페이지만 바로 디스크에 씁니다. */
+	if (!zswap_store(table_idx, frame->kva))
+		for(int i=0; i<8; i++){
+			disk_write(swap_disk, (table_idx * 8) + i, frame->kva + (DISK_SECTOR_SIZE * i));
+		}
 
+	/* 프레임과의 연결은 vm_evict_frame()이 rmap을 따라 한꺼번에 끊습니다. */
 	anon_page->swap_idx=table_idx;
 
 	return true;
@@ -127,20 +275,13 @@ anon_destroy(struct page *page)
 {
     struct anon_page *anon_page = &page->anon;
 
-    pml4_clear_page(thread_current()->pml4, page->va);
+    // fork로 공유 중인 프레임이면 참조만 놓습니다. PTE도 이 안에서 지웁니다.
+    // 먼저 프레임을 놓아야 그 사이 교체되면서 새 스왑 슬롯을 받는 일이 없습니다.
+    vm_frame_unref(page);
 
     if (anon_page->swap_idx != -1)
-        bitmap_set(swap_table, anon_page->swap_idx, false);
-
-    if (page->frame != NULL) {
-		page->frame->r_cnt--;
-		if(page->frame->r_cnt==0){
-			list_remove(&page->frame->frame_elem);
-			palloc_free_page(page->frame->kva);
-			page->frame->page = NULL; // 연결 해제 (구현에 따라)
-			free(page->frame);
-		}
-    }
+        swap_slot_release(page);
+    anon_drop_backing(page);
 
 	
 }
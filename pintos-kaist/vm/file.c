@@ -1,15 +1,20 @@
 /* file.c: Implementation of memory backed file object (mmaped object). */
 
+#include <string.h>
 #include "vm/vm.h"
+#include "threads/malloc.h"
 #include "threads/vaddr.h"
 #include "userprog/process.h"
 #include "threads/mmu.h"
+#include "threads/palloc.h"
+#include "lib/user/syscall.h"
+
+#define MSYNC_BATCH 8 /* msync가 한 번의 file_write_at으로 묶는 최대 페이지 수 */
 
 static bool file_backed_swap_in(struct page *page, void *kva);
 static bool file_backed_swap_out(struct page *page);
 static void file_backed_destroy(struct page *page);
 
-static bool lazy_load_file(struct page *page, void *aux);
 
 /* DO NOT MODIFY this struct */
 static const struct page_operations file_ops = {
@@ -23,199 +28,423 @@ static const struct page_operations file_ops = {
 void vm_file_init(void)
 {
 	/* 전역 자료구조 초기화 */
-	/** TODO: mmap 리스트 초기화
-	 * mmap으로 만들어진 페이지를 리스트로 관리하면
-	 * munmmap 시에 더 빠르게 할 수 있을 듯 합니다
-	 *
-	 */
+	/* mmap 영역은 프로세스마다 supplemental_page_table.vmas에서 관리합니다. */
 }
 
 /* Initialize the file backed page */
+/* 파일 페이지는 자신이 속한 VMA만 가리키고, 파일 위치는 가상 주소로부터 계산합니다. */
 bool file_backed_initializer(struct page *page, enum vm_type type, void *kva)
 {
 	/* Set up the handler */
 	page->operations = &file_ops;
 
 	struct file_page *file_page = &page->file;
-	file_page->aux = page->uninit.aux;
-	/** TODO: file 백업 정보를 초기화
-	 * file_page에 어떤 정보가 있는지에 따라 다름
-	 */
+	file_page->vma = page->uninit.aux;
 	return true;
 }
 
+/* PAGE에 대응하는 파일 오프셋을 반환합니다. */
+off_t
+file_page_offset(struct page *page)
+{
+	struct vma *vma = page->file.vma;
+	return vma->ofs + (page->va - vma->start);
+}
+
+/* PAGE가 파일에서 읽어 올 바이트 수를 반환합니다. 나머지는 0으로 채웁니다. */
+uint32_t
+file_page_read_bytes(struct page *page)
+{
+	struct vma *vma = page->file.vma;
+	size_t page_ofs = page->va - vma->start;
+
+	if (page_ofs >= vma->length)
+		return 0;
+	return vma->length - page_ofs < PGSIZE ? vma->length - page_ofs : PGSIZE;
+}
+
 /* 파일에서 내용을 읽어와 페이지를 스왑인합니다. */
 static bool
 file_backed_swap_in(struct page *page, void *kva)
 {
-	// swap_in을 위한 버퍼
-	// void *buffer[PGSIZE];
-	/** TODO: 파일에서 정보를 읽어와 kva에 복사하세요
-	 * aux에 저장된 백업 정보를 사용하세요
-	 * file_open과 read를 사용하면 될 것 같아요
-	 * 파일 시스템 동기화가 필요할수도 있어요
-	 * 필요시 file_backed_initializer를 수정하세요
-	 */
-
-	struct file_page *file_page = &page->file;
-	struct file_info * aux = file_page->aux;
-	struct file *file = aux->file;
-	size_t length= aux->read_bytes;
-	off_t offset = aux->ofs;
+	struct file *file = page->file.vma->file;
+	uint32_t read_bytes = file_page_read_bytes(page);
+	off_t offset = file_page_offset(page);
 
 	lock_acquire(&filesys_lock);
-	if (file_read_at(file, kva, length, offset) != (int)length) {
-        // 읽기 실패 시 처리
-		lock_release(&filesys_lock);
-        return false;
-    }
+	off_t bytes_read = file_read_at(file, kva, read_bytes, offset);
 	lock_release(&filesys_lock);
 
-	size_t page_zero_bytes = PGSIZE - length;
-    if (page_zero_bytes > 0) {
-        memset(kva + length, 0, page_zero_bytes);
-    }
+	/* 파일 끝을 넘어가는 부분은 0으로 채웁니다. */
+	memset(kva + bytes_read, 0, PGSIZE - bytes_read);
+	return true;
+}
+
+/* PAGE가 dirty면 파일에 write-back 하고 dirty 비트를 지웁니다. */
+static void
+file_page_writeback(struct page *page, uint64_t *pml4)
+{
+	if (page->frame == NULL || !pml4_is_dirty(pml4, page->va))
+		return;
 
-    return true;
+	lock_acquire(&filesys_lock);
+	file_write_at(page->file.vma->file, page->frame->kva,
+				  file_page_read_bytes(page), file_page_offset(page));
+	lock_release(&filesys_lock);
+	pml4_set_dirty(pml4, page->va, 0);
 }
 
 /* 페이지의 내용을 파일에 기록(writeback)하여 스왑아웃합니다. */
 static bool
 file_backed_swap_out(struct page *page)
 {
-	/** TODO: dirty bit 확인해서 write back
-	 * pml4_is_dirty를 사용해서 dirty bit를 확인하세요
-	 * write back을 할 때는 aux에 저장된 파일 정보를 사용
-	 * file_write를 사용하면 될 것 같아요
-	 * dirty_bit 초기화 (pml4_set_dirty)
-	 */
-	struct file_page *file_page = &page->file;
-	struct file_info *aux=file_page->aux;
-
-	uint32_t read_bytes = aux->read_bytes;
-	uint32_t zero_bytes = aux->zero_bytes;
-	struct file * file = aux->file;
-	off_t offset=aux->ofs;
-
-	if(pml4_is_dirty(thread_current()->pml4, page->va)){
-		
-		lock_acquire(&filesys_lock);
-		file_write_at(file, page->frame->kva, read_bytes, offset);
-		lock_release(&filesys_lock);
-		pml4_set_dirty(thread_current()->pml4, page->va, 0);
-	}
-
-	// page->frame->page=NULL;
-	// page->frame=NULL;
-
+	/* 교체는 다른 프로세스의 문맥에서도 일어나므로 소유자의 pml4를 봅니다. */
+	file_page_writeback(page, page->owner->pml4);
 	return true;
-
 }
 
-/* 파일 기반 페이지를 소멸시킵니다. PAGE는 호출자가 해제합니다. */
+/* 파일 기반 페이지를 소멸시킵니다. PAGE는 호출자가 해제합니다.
+ * VMA와 그 파일은 munmap이나 프로세스 종료 때 따로 정리합니다. */
 static void
 file_backed_destroy(struct page *page)
 {
-	struct file_page *file_page = &page->file;
-	struct file_info *aux=file_page->aux;
-	uint32_t read_bytes = aux->read_bytes;
-	uint32_t zero_bytes = aux->zero_bytes;
-	struct file * file = aux->file;
-	off_t offset=aux->ofs;
-
-	if(pml4_is_dirty(thread_current()->pml4, page->va)){
-		
-		lock_acquire(&filesys_lock);
-		file_write_at(file, page->frame->kva, read_bytes, offset);
-		lock_release(&filesys_lock);
-		pml4_set_dirty(thread_current()->pml4, page->va, 0);
-	}
+	file_page_writeback(page, thread_current()->pml4);
+
+	// fork로 공유 중인 프레임이면 참조만 놓고, 마지막 참조일 때 해제
+	// 사용자 가상 주소 공간의 매핑도 이 안에서 프레임 락을 잡은 채로 제거합니다
+	vm_frame_unref(page);
+}
 
-	if (page->frame != NULL)
+static bool
+vma_less(const struct list_elem *a, const struct list_elem *b, void *aux UNUSED)
+{
+	return list_entry(a, struct vma, elem)->start < list_entry(b, struct vma, elem)->start;
+}
+
+/* SPT에서 ADDR을 포함하는 VMA를 찾습니다. 없으면 NULL을 반환합니다. */
+struct vma *
+vma_find(struct supplemental_page_table *spt, const void *addr)
+{
+	struct list_elem *e;
+	for (e = list_begin(&spt->vmas); e != list_end(&spt->vmas); e = list_next(e))
 	{
-		// 물리 페이지를 해제하고, frame 구조체도 동적 메모리 해제
-		palloc_free_page(page->frame->kva);
-		free(page->frame);
-		page->frame = NULL;
-	}	
-	
-	// 최종적으로 사용자 가상 주소 공간에서 해당 페이지 매핑을 제거
-	pml4_clear_page(thread_current()->pml4, page->va);
+		struct vma *vma = list_entry(e, struct vma, elem);
+		if (addr < vma->start)
+			break;
+		if (addr < vma->end)
+			return vma;
+	}
+	return NULL;
+}
 
-	free(aux);
+/* [START, END) 와 겹치는 VMA가 있으면 true를 반환합니다. */
+bool
+vma_overlaps(struct supplemental_page_table *spt, const void *start, const void *end)
+{
+	struct list_elem *e;
+	for (e = list_begin(&spt->vmas); e != list_end(&spt->vmas); e = list_next(e))
+	{
+		struct vma *vma = list_entry(e, struct vma, elem);
+		if (vma->start >= end)
+			break;
+		if (vma->end > start)
+			return true;
+	}
+	return false;
 }
 
-/* Do the mmap */
-/*
-파일의 길이가 PGSIZE의 배수가 아니면 마지막 페이지는 일부만 유효하고,
-나머지 바이트는 0으로 초기화.
-*/
+/* SRC의 VMA들을 DST에 복사합니다. 파일은 매핑마다 한 번씩만 reopen 합니다. */
+bool
+vma_copy(struct supplemental_page_table *dst, struct supplemental_page_table *src)
+{
+	struct list_elem *e;
+	for (e = list_begin(&src->vmas); e != list_end(&src->vmas); e = list_next(e))
+	{
+		struct vma *src_vma = list_entry(e, struct vma, elem);
+		struct vma *vma = malloc(sizeof *vma);
+		if (vma == NULL)
+			return false;
+
+		*vma = *src_vma;
+		if (src_vma->file != NULL)
+			vma->file = file_reopen(src_vma->file);
+		list_push_back(&dst->vmas, &vma->elem);
+	}
+	return true;
+}
 
+/* SPT의 모든 VMA를 해제합니다. 페이지들은 먼저 정리되어 있어야 합니다. */
+void
+vma_kill(struct supplemental_page_table *spt)
+{
+	while (!list_empty(&spt->vmas))
+	{
+		struct vma *vma = list_entry(list_pop_front(&spt->vmas), struct vma, elem);
+		file_close(vma->file);
+		free(vma);
+	}
+}
 
+/* Do the mmap */
+/* ADDR부터 LENGTH 바이트를 FILE의 OFFSET부터 매핑하는 VMA 하나를 만듭니다.
+ * 페이지 구조체는 만들지 않고, 폴트가 나서 내용이 필요해질 때 만듭니다.
+ * 파일의 길이가 PGSIZE의 배수가 아니면 마지막 페이지는 일부만 유효하고,
+ * 나머지 바이트는 0으로 초기화.
+ * FILE이 NULL이면 익명 매핑입니다. 폴트가 나면 VMA에서 0 페이지를 만들고,
+ * 읽기만 하는 페이지는 zero 프레임을, 2MB 구간은 큰 페이지를 씁니다. */
 void *
 do_mmap(void *addr, size_t length, int writable,
-		struct file *file, off_t offset, size_t mmap_length)
+		struct file *file, off_t offset)
 {
-	// aux에 넣어줄 정보
-	struct file_info *aux = malloc(sizeof(struct file_info));
-	ASSERT(aux!=NULL);
-
-	aux->file=file_reopen(file);
-	aux->ofs=offset;
-	aux->upage=addr;
-	aux->read_bytes=length; //한 페이지당 읽어와야할 바이트 수
-	aux->zero_bytes=PGSIZE-length;
-	aux->writable=writable;
-	aux->mmap_length = mmap_length;
-
+	struct vma *vma = malloc(sizeof *vma);
+	if (vma == NULL)
+		return NULL;
 
-	// TODO: 지연 로딩 함수 포인터 집어넣기
-	if(!vm_alloc_page_with_initializer(VM_FILE, addr, writable, lazy_load_segment, aux)) //<<어떻게 lazy_load_segemnt를 집어넣지?
+	vma->file = NULL;
+	if (file != NULL && (vma->file = file_reopen(file)) == NULL) {
+		free(vma);
 		return NULL;
+	}
+	vma->start = addr;
+	vma->end = pg_round_up(addr + length);
+	vma->ofs = offset;
+	vma->length = length;
+	vma->writable = writable;
+	vma->advice = VMA_NORMAL;
+
+	list_insert_ordered(&thread_current()->spt.vmas, &vma->elem, vma_less, NULL);
 	return addr;
 }
 
+/* Do the munmap */
+/* ADDR에서 시작하는 매핑 전체를 해제합니다. 올라와 있던 페이지만 SPT에 있으므로 그것들만 정리합니다.
+ * 언매핑시 0으로 채워진 부분은 파일에 반영하지 않아야 함. */
+void do_munmap(void *addr)
+{
+	struct supplemental_page_table *spt = &thread_current()->spt;
+	struct vma *vma = vma_find(spt, addr);
+	if (vma == NULL || vma->start != addr)
+		return;
 
+	vma_drop_range(spt, vma->start, vma->end);
 
-static void
-munmap_cleaner(struct page *page)
+	list_remove(&vma->elem);
+	file_close(vma->file);
+	free(vma);
+}
+
+/* [START, END)를 덮는 익명 VMA를 NEW_END까지 늘립니다. 그런 VMA가 없으면 [END, NEW_END)를 덮는 익명 VMA를 새로 만듭니다.
+ * 힙(brk)이 자랄 때 쓰며, 페이지는 폴트가 나면 VMA에서 만듭니다. 메모리가 없으면 false를 반환합니다. */
+bool
+vma_extend(struct supplemental_page_table *spt, void *start, void *end, void *new_end)
 {
-	struct file_info * aux;
-	if(page->operations->type==VM_FILE){
-		aux = page->file.aux;
-	}else{
-	    aux= (struct file_info *)page->uninit.aux;
+	struct list_elem *e;
+	for (e = list_begin(&spt->vmas); e != list_end(&spt->vmas); e = list_next(e))
+	{
+		struct vma *vma = list_entry(e, struct vma, elem);
+		if (vma->start == start && vma->end == end && vma->file == NULL)
+		{
+			vma->end = new_end;
+			vma->length = new_end - vma->start;
+			return true;
+		}
 	}
+	return do_mmap(end, new_end - end, true, NULL, 0) != NULL;
+}
 
-	uint32_t read_bytes=aux->read_bytes;
-	uint32_t zero_bytes=aux->zero_bytes;
-	struct file* file = aux->file;
-	off_t offset=aux->ofs;
-
-	
-	if(pml4_is_dirty(thread_current()->pml4, page->va)){
-		
-		lock_acquire(&filesys_lock);
-		file_write_at(file, page->frame->kva, read_bytes, offset);
-		lock_release(&filesys_lock);
-		pml4_set_dirty(thread_current()->pml4, page->va, 0);
+/* [START, END)의 페이지를 내려놓고, 그 구간에 든 VMA를 START에서 자릅니다. 남는 부분이 없는 VMA는 없앱니다.
+ * 힙(brk)이 줄어들 때 쓰며, END를 넘어가는 VMA는 힙이 아니므로 건드리지 않습니다. */
+void
+vma_truncate(struct supplemental_page_table *spt, void *start, void *end)
+{
+	vma_drop_range(spt, start, end);
+
+	struct list_elem *e = list_begin(&spt->vmas);
+	while (e != list_end(&spt->vmas))
+	{
+		struct vma *vma = list_entry(e, struct vma, elem);
+		e = list_next(e);
+		if (vma->end <= start)
+			continue;
+		if (vma->start >= end)
+			break;
+		if (vma->end > end)
+			continue;
+
+		if (vma->start >= start)
+		{
+			list_remove(&vma->elem);
+			file_close(vma->file);
+			free(vma);
+		}
+		else
+		{
+			vma->end = start;
+			vma->length = start - vma->start;
+		}
 	}
-	free(aux);
 }
 
+/* mmap 구간 [START, END)에 만들어진 페이지를 모두 내려놓습니다. VMA는 그대로 남습니다.
+ * dirty 페이지는 파일에 반영되므로, 다시 접근하면 파일에서 같은 내용을 읽어 옵니다. */
+void
+vma_drop_range(struct supplemental_page_table *spt, void *start, void *end)
+{
+	// 구간 전체의 매핑을 한 번에 내리고, 페이지마다 write-back과 프레임 정리를 합니다
+	pml4_clear_range(thread_current()->pml4, start, end);
+	for (void *va = start; va < end; va += PGSIZE)
+	{
+		struct page *page = spt_find_page(spt, va);
+		if (page == NULL)
+			continue;
 
-/* Do the munmap */
-/* 언매핑시 0으로 채워진 부분은 파일에 반영하지 않아야 함.*/
-void do_munmap(void *addr)
+		// 페이지 제거 (dirty면 write-back, 프레임 참조 해제)
+		spt_remove_page(spt, page);
+		vm_dealloc_page(page);
+	}
+}
+
+/* [ADDR, ADDR + LENGTH)가 모두 mmap 구간 안에 있으면 true를 반환합니다. */
+static bool
+vma_covers(struct supplemental_page_table *spt, void *addr, void *end)
 {
-	struct thread *thread = thread_current(); 
-	struct page *page = spt_find_page(&thread->spt, addr);
-	ASSERT(page != NULL);
-		
-	// 페이지 제거
-	hash_delete(&thread->spt.spt_hash, &page->hash_elem);
-	munmap_cleaner(page);
-	// free(page);
-	pml4_clear_page(thread->pml4, pg_round_down(addr));
+	for (void *va = addr; va < end;)
+	{
+		struct vma *vma = vma_find(spt, va);
+		if (vma == NULL)
+			return false;
+		va = vma->end;
+	}
+	return true;
+}
+
+/* ADDR부터 LENGTH 바이트의 mmap 구간에 ADVICE를 적용합니다.
+ * WILLNEED는 미리 읽고 DONTNEED는 바로 내려놓으며, 나머지는 VMA에 접근 패턴으로 남겨
+ * 이후 폴트 때 readahead 폭을 정합니다. VMA를 쪼개지는 않으므로 패턴은 구간이 걸친 VMA 전체에 적용됩니다.
+ * 구간이 mmap 밖으로 나가거나 ADVICE가 잘못되면 -1을 반환합니다. */
+int
+do_madvise(void *addr, size_t length, int advice)
+{
+	struct supplemental_page_table *spt = &thread_current()->spt;
+	void *end = pg_round_up(addr + length);
+
+	if (advice < MADV_NORMAL || advice > MADV_DONTNEED || !vma_covers(spt, addr, end))
+		return -1;
+
+	for (void *va = addr; va < end;)
+	{
+		struct vma *vma = vma_find(spt, va);
+		void *stop = vma->end < end ? vma->end : end;
+
+		switch (advice)
+		{
+		case MADV_NORMAL:
+			vma->advice = VMA_NORMAL;
+			break;
+		case MADV_RANDOM:
+			vma->advice = VMA_RANDOM;
+			break;
+		case MADV_SEQUENTIAL:
+			vma->advice = VMA_SEQUENTIAL;
+			break;
+		case MADV_WILLNEED:
+			vm_prefetch(va, stop);
+			break;
+		case MADV_DONTNEED:
+			vma_drop_range(spt, va, stop);
+			break;
+		}
+		va = stop;
+	}
+	return 0;
+}
+
+/* PAGE가 올라와 있고 dirty면 내용을 DST에 복사하고 dirty 비트를 지운 뒤 true를 반환합니다.
+ * 복사하는 동안 pageout 데몬이 프레임을 내보내지 않도록 frame_lock을 잡습니다. */
+static bool
+file_page_take_dirty(struct page *page, uint64_t *pml4, void *dst)
+{
+	bool dirty = false;
+
+	lock_acquire(&frame_table->frame_lock);
+	if (VM_TYPE(page->operations->type) == VM_FILE && page->frame != NULL &&
+		pml4_is_dirty(pml4, page->va))
+	{
+		memcpy(dst, page->frame->kva, PGSIZE);
+		pml4_set_dirty(pml4, page->va, false);
+		dirty = true;
+	}
+	lock_release(&frame_table->frame_lock);
+	return dirty;
+}
+
+/* VMA의 VA부터 PAGE_CNT 페이지 내용을 담은 BUF를 한 번에 파일에 씁니다.
+ * 파일 길이를 넘어 0으로 채운 부분은 쓰지 않습니다. */
+static void
+msync_write(struct vma *vma, void *va, const void *buf, size_t page_cnt)
+{
+	size_t ofs = va - vma->start;
+	if (ofs >= vma->length)
+		return;
+
+	size_t bytes = page_cnt * PGSIZE;
+	if (bytes > vma->length - ofs)
+		bytes = vma->length - ofs;
+
+	lock_acquire(&filesys_lock);
+	file_write_at(vma->file, buf, bytes, vma->ofs + ofs);
+	lock_release(&filesys_lock);
+}
+
+/* ADDR부터 LENGTH 바이트의 mmap 구간에서 dirty 페이지를 파일에 반영합니다.
+ * 이어진 dirty 페이지는 MSYNC_BATCH 개까지 버퍼에 모아 file_write_at 한 번으로 씁니다.
+ * dirty 페이지가 없는 VMA는 페이지 테이블만 한 번 훑고 넘어갑니다.
+ * 구간이 mmap 밖으로 나가거나 버퍼를 얻지 못하면 -1을 반환합니다. */
+int
+do_msync(void *addr, size_t length)
+{
+	struct thread *curr = thread_current();
+	struct supplemental_page_table *spt = &curr->spt;
+	void *end = pg_round_up(addr + length);
+
+	if (!vma_covers(spt, addr, end))
+		return -1;
+
+	uint8_t *buf = palloc_get_multiple(0, MSYNC_BATCH);
+	if (buf == NULL)
+		return -1;
+
+	for (void *va = addr; va < end;)
+	{
+		struct vma *vma = vma_find(spt, va);
+		void *stop = vma->end < end ? vma->end : end;
+
+		/* 익명 매핑은 반영할 파일이 없습니다. */
+		if (vma->file != NULL && pml4_is_dirty_range(curr->pml4, va, stop))
+		{
+			void *run_start = NULL;
+			size_t run_cnt = 0;
+
+			for (; va < stop; va += PGSIZE)
+			{
+				struct page *page = spt_find_page(spt, va);
+				if (page != NULL && file_page_take_dirty(page, curr->pml4, buf + run_cnt * PGSIZE))
+				{
+					if (run_cnt++ == 0)
+						run_start = va;
+					if (run_cnt < MSYNC_BATCH)
+						continue;
+				}
+				if (run_cnt > 0)
+					msync_write(vma, run_start, buf, run_cnt);
+				run_cnt = 0;
+			}
+			if (run_cnt > 0)
+				msync_write(vma, run_start, buf, run_cnt);
+		}
+		va = stop;
+	}
 
+	palloc_free_multiple(buf, MSYNC_BATCH);
+	return 0;
 }
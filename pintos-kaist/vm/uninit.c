@@ -9,6 +9,7 @@
 
 #include "vm/vm.h"
 #include "vm/uninit.h"
+#include "userprog/process.h"
 
 static bool uninit_initialize (struct page *page, void *kva);
 static void uninit_destroy (struct page *page);
@@ -49,11 +50,18 @@ uninit_initialize (struct page *page, void *kva) {
 	/* 먼저 가져옵니다. page_initialize가 값을 덮어쓸 수 있습니다. */
 	vm_initializer *init = uninit->init;
 	void *aux = uninit->aux;
+	enum vm_type type = uninit->type;
 
 	/* TODO: 이 함수를 수정해야 할 수도 있습니다. */
 	//여기에서 init이 존재하면 lazy_load_segment(page, aux)가 호출됨. 없는 경우 그냥 true -> 그래서 수정이 필요한 걸수도 
-	return uninit->page_initializer (page, uninit->type, kva) &&
-		(init ? init (page, aux) : true);
+	if (!uninit->page_initializer (page, type, kva) ||
+		!(init ? init (page, aux) : true))
+		return false;
+
+	/* 실행 파일에서 읽은 익명 페이지는 aux를 넘겨받아, 깨끗한 채로 교체되면 다시 읽어 옵니다. */
+	if (VM_TYPE (type) == VM_ANON && init == lazy_load_segment)
+		page->anon.backing = aux;
+	return true;
 }
 
 /* uninit_page가 보유한 리소스를 해제합니다. 대부분의 페이지는 다른 페이지 객체로 변환되지만,
@@ -64,7 +72,7 @@ uninit_destroy (struct page *page) {
 	struct file_info *aux = (struct file_info *)page->uninit.aux;
     if (aux != NULL) {
         file_close(aux->file);  // 파일 핸들 닫기
-        free(aux);              // aux 메모리 해제
+        kmem_cache_free(file_info_cachep, aux); // aux 메모리 해제
     }
 	return;
 }
\ No newline at end of file
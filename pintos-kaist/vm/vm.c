@@ -1,13 +1,95 @@
 /* vm.c: Generic interface for virtual memory objects. */
 
+#include <stdio.h>
+#include <string.h>
 #include "threads/malloc.h"
+#include "threads/palloc.h"
 #include "vm/vm.h"
 #include "vm/inspect.h"
 #include "threads/mmu.h"
 #include "userprog/process.h"
+#include "filesys/inode.h"
+#include "devices/timer.h"
 #define STACK_GROW_RANGE 4192
+#define SWAP_READAHEAD 4 /* 스왑 인 폴트 때 함께 읽어 올 이웃 슬롯 수 */
+#define FAULT_AROUND 8	 /* 파일 페이지 폴트 때 함께 채울 이웃 페이지 수 */
+#define FAULT_AROUND_SEQ 32 /* MADV_SEQUENTIAL 구간에서 함께 채울 이웃 페이지 수 */
 struct frame_table *frame_table;
 
+/* 빈 유저 페이지가 vm_low_watermark 아래로 떨어지면 pageout 데몬을 깨우고,
+ * 데몬은 vm_high_watermark 만큼 빈 페이지가 생길 때까지 프레임을 내보냅니다. */
+size_t vm_low_watermark;
+size_t vm_high_watermark;
+static struct semaphore pageout_sema;
+static bool pageout_requested; /* frame_lock으로 보호 */
+
+static void pageout_init(void);
+
+/* KSM(same-page merging) 스캐너
+ * 낮은 우선순위 스레드가 프레임 테이블을 조금씩 돌면서 내용이 같은 익명 프레임을 찾아 하나로 합칩니다.
+ * 합친 프레임은 fork 때처럼 읽기 전용으로 공유되고, 쓰는 쪽이 vm_handle_wp()에서 복사본을 가져갑니다.
+ * 두 번 연속 같은 해시가 나온 (자주 바뀌지 않는) 프레임만 후보 테이블에 올립니다.
+ * 후보 테이블은 한 바퀴를 돌 때마다 비우며, frame_lock으로 보호합니다.
+ * read 시스템 콜의 버퍼도 합쳐질 수 있지만, 파일 내용은 커널 페이지를 거쳐 filesys_lock 밖에서 복사하므로
+ * 그 쓰기 폴트가 filesys_lock을 쥔 채 교체(write-back)까지 가는 일은 없습니다. */
+#define KSM_SLEEP_TICKS 20
+size_t vm_ksm_scan_pages = 64;
+
+/* -lp 옵션으로 켜는 2MB 큰 페이지 매핑과, 지금까지 만든 큰 페이지 수 */
+bool vm_large_pages;
+static size_t vm_large_cnt;
+static struct hash ksm_table;
+static size_t ksm_scanned, ksm_passes, ksm_merged;
+
+/* 프로세스별 상주 집합 제한과 working set 샘플러
+ * 샘플러는 vm_ws_ticks마다 프레임 테이블을 한 바퀴 돌면서 PTE의 accessed 비트를 소유자별로 세고,
+ * 센 비트는 frame->referenced로 옮긴 뒤 지웁니다. 한 구간 동안 센 수가 그 프로세스의 working set입니다.
+ * 상주 프레임이 working set보다 많은 프로세스는 최근에 쓰지 않은 페이지를 들고 있는 셈이므로
+ * 교체할 때 그 프로세스들의 프레임을 먼저 내보냅니다. ws_over_cnt는 마지막 샘플에서 그런 프로세스 수입니다.
+ * 상주 프레임이 vm_rss_limit에 닿은 프로세스는 다른 프로세스 대신 자기 프레임을 내보냅니다. */
+size_t vm_rss_limit;
+int64_t vm_ws_ticks = 100;
+static bool ws_running;
+static unsigned ws_gen;
+static size_t ws_over_cnt;
+static void ws_init(void);
+
+/* OOM 킬러
+ * 유저 풀과 스왑이 모두 가득 차서 내보낼 프레임이 없으면, 상주 프레임과 스왑 슬롯을 합해 가장 많이 쓰는
+ * 유저 프로세스에 종료를 요청합니다(killed). 그 프로세스는 유저 모드로 돌아가기 직전에 exit(-1)로 끝나고,
+ * 그때 프레임과 슬롯이 풀립니다. 할당하던 스레드는 frame_lock을 놓고 OOM_WAIT_TICKS씩 기다리며 다시 시도하고,
+ * OOM_RETRIES번 안에 메모리가 생기지 않거나 자기가 선택되면 할당에 실패합니다.
+ * 메모리가 부족해질 때마다 lowmem_cond를 깨워서 mem_notify()로 기다리는 프로그램에 알립니다. */
+#define OOM_WAIT_TICKS 5
+#define OOM_RETRIES 20
+static struct condition lowmem_cond; /* frame_lock으로 보호 */
+static bool oom_kill(void);
+
+/* 교체는 스왑·write-back I/O 동안 frame_lock을 놓습니다. 그 사이 희생 프레임의 rmap을 건드리려는
+ * 스레드는 evict_cond에서 기다립니다. frame_lock으로 보호합니다. */
+static struct condition evict_cond;
+static void page_wait_evict(struct page *page);
+static uint64_t ksm_hash(const struct hash_elem *e, void *aux);
+static bool ksm_less(const struct hash_elem *a, const struct hash_elem *b, void *aux);
+static void ksm_forget(struct frame *frame);
+static void ksm_init(void);
+
+/* (inode 섹터, 오프셋)으로 이미 올라와 있는 읽기 전용 실행 파일 프레임을 찾는 전역 테이블입니다.
+ * 같은 실행 파일을 여러 프로세스가 exec해도 text 페이지는 한 번만 읽습니다. frame_lock으로 보호합니다. */
+static struct hash share_table;
+static uint64_t share_hash(const struct hash_elem *e, void *aux);
+static bool share_less(const struct hash_elem *a, const struct hash_elem *b, void *aux);
+
+/* 커널이 소유한 0으로 채워진 프레임입니다. 아직 쓰지 않은 익명 페이지에 읽기 전용으로 매핑하고,
+ * 처음 쓸 때 vm_handle_wp()에서 진짜 프레임을 받습니다. 프레임 테이블에 없으므로 교체되지 않습니다. */
+static struct frame zero_frame;
+static void zero_frame_init(void);
+
+struct kmem_cache *page_cachep;
+struct kmem_cache *frame_cachep;
+struct kmem_cache *file_info_cachep;
+static void frame_ctor(void *);
+
 /* 각 서브시스템의 초기화 코드를 호출하여 가상 메모리 서브시스템을 초기화합니다. */
 void vm_init(void)
 {
@@ -20,7 +102,14 @@ void vm_init(void)
 	/* 이 위쪽은 수정하지 마세요 !! */
 	/* TODO: 이 아래쪽부터 코드를 추가하세요 */
 
+	page_cachep = kmem_cache_create("page", sizeof(struct page), NULL);
+	frame_cachep = kmem_cache_create("frame", sizeof(struct frame), frame_ctor);
+	file_info_cachep = kmem_cache_create("file_info", sizeof(struct file_info), NULL);
 	frame_table_init();
+	zero_frame_init();
+	pageout_init();
+	ksm_init();
+	ws_init();
 }
 
 /* 페이지의 타입을 가져옵니다. 이 함수는 페이지가 초기화된 후 타입을 알고 싶을 때 유용합니다.
@@ -31,214 +120,1424 @@ page_get_type(struct page *page)
 	int ty = VM_TYPE(page->operations->type);
 	switch (ty)
 	{
-	case VM_UNINIT:
-		return VM_TYPE(page->uninit.type);
-	default:
-		return ty;
+	case VM_UNINIT:
+		return VM_TYPE(page->uninit.type);
+	default:
+		return ty;
+	}
+}
+
+void frame_table_init(){
+	frame_table = malloc(sizeof(struct frame_table));
+	list_init(&frame_table->frame_list);
+	lock_init(&frame_table->frame_lock);
+	cond_init(&evict_cond);
+	frame_table->clock_hand = NULL;
+	frame_table->ksm_hand = NULL;
+	hash_init(&share_table, share_hash, share_less, NULL);
+	hash_init(&ksm_table, ksm_hash, ksm_less, NULL);
+}
+
+static uint64_t
+share_hash(const struct hash_elem *e, void *aux UNUSED)
+{
+	const struct frame *frame = hash_entry(e, struct frame, share_elem);
+	return hash_bytes(&frame->share_key, sizeof frame->share_key);
+}
+
+static bool
+share_less(const struct hash_elem *a, const struct hash_elem *b, void *aux UNUSED)
+{
+	const struct share_key *ka = &hash_entry(a, struct frame, share_elem)->share_key;
+	const struct share_key *kb = &hash_entry(b, struct frame, share_elem)->share_key;
+
+	if (ka->sector != kb->sector)
+		return ka->sector < kb->sector;
+	if (ka->ofs != kb->ofs)
+		return ka->ofs < kb->ofs;
+	return ka->read_bytes < kb->read_bytes;
+}
+
+/* PAGE가 실행 파일 내용을 그대로 담는 읽기 전용 페이지면 KEY를 채우고 true를 반환합니다.
+ * 실행 파일 세그먼트(lazy_load_segment로 채우는 uninit 페이지나 버렸다가 다시 읽는 익명 페이지)만 해당됩니다.
+ * 실행 중인 파일은 file_deny_write()로 쓰기가 막혀 있어 공유한 프레임이 낡지 않습니다.
+ * mmap 파일은 write()나 다른 프로세스의 쓰기 가능한 매핑으로 바뀔 수 있으므로 공유하지 않습니다. */
+static bool
+page_share_key(struct page *page, struct share_key *key)
+{
+	if (page->writable)
+		return false;
+
+	memset(key, 0, sizeof *key);
+	struct file_info *info = NULL;
+	if (VM_TYPE(page->operations->type) == VM_UNINIT && page->uninit.init == lazy_load_segment)
+		info = page->uninit.aux;
+	else if (VM_TYPE(page->operations->type) == VM_ANON && page->anon.swap_idx == -1)
+		info = page->anon.backing;
+	if (info == NULL)
+		return false;
+	key->sector = inode_get_inumber(file_get_inode(info->file));
+	key->ofs = info->ofs;
+	key->read_bytes = info->read_bytes < PGSIZE ? info->read_bytes : PGSIZE;
+	return true;
+}
+
+/* KEY에 해당하는 프레임이 올라와 있으면 반환합니다. */
+static struct frame *
+share_table_find(const struct share_key *key)
+{
+	struct frame probe;
+	probe.share_key = *key;
+
+	struct hash_elem *e = hash_find(&share_table, &probe.share_elem);
+	return e != NULL ? hash_entry(e, struct frame, share_elem) : NULL;
+}
+
+/* 내용을 다 읽은 FRAME을 KEY로 등록합니다. 다른 프로세스가 먼저 등록했다면 그대로 둡니다. */
+static void
+share_table_insert(struct frame *frame, const struct share_key *key)
+{
+	ASSERT(!frame->shared_ro);
+	frame->share_key = *key;
+	if (hash_insert(&share_table, &frame->share_elem) == NULL)
+		frame->shared_ro = true;
+}
+
+/* FRAME이 다른 내용으로 재사용되거나 해제되기 전에 테이블에서 뺍니다. */
+static void
+share_table_remove(struct frame *frame)
+{
+	if (frame->shared_ro)
+	{
+		hash_delete(&share_table, &frame->share_elem);
+		frame->shared_ro = false;
+	}
+}
+
+
+/* Helpers */
+static struct frame *vm_get_victim(struct thread *owner);
+static struct frame *frame_create(void *kva);
+static void pageout_poke(void);
+static bool vm_claim_large_page(void *va);
+static bool vm_do_claim_page(struct page *page);
+static struct frame *vm_evict_frame(struct thread *owner);
+static bool page_transmute(struct page *dst, void *kva);
+static void vm_swap_readahead(int swap_idx);
+static void vm_fault_around(void *va, struct inode *inode, off_t ofs, int window);
+static void vma_drop_behind(struct vma *vma, void *va);
+static struct page *vma_materialize(struct vma *vma, void *va);
+
+/* 초기화 함수와 함께 대기 중인 페이지 객체를 생성합니다. 페이지를 직접 생성하지 말고,
+ * 반드시 이 함수나 `vm_alloc_page`를 통해 생성하세요. */
+bool vm_alloc_page_with_initializer(enum vm_type type, void *upage, bool writable,
+									vm_initializer *init, void *aux)
+{
+
+	struct supplemental_page_table *spt = &thread_current()->spt;
+	ASSERT(spt!=NULL);
+
+	/* 이미 해당 page가 SPT에 존재하는지 확인합니다 */
+	if (spt_find_page(spt, upage) == NULL)
+	{
+		/* TODO: VM 타입에 따라 페이지를 생성하고, 초기화 함수를 가져온 뒤,
+		 * TODO: uninit_new를 호출하여 "uninit" 페이지 구조체를 생성하세요.
+		 * TODO: uninit_new 호출 후에는 필요한 필드를 수정해야 합니다. */
+		bool (*page_initializer)(struct page *, enum vm_type, void *kva);
+		struct page *page = kmem_cache_alloc(page_cachep);
+		if (page == NULL)
+			goto err; // 커널 풀이 바닥나면 패닉 대신 호출자(시스템 콜, 폴트)가 실패합니다
+
+		switch (VM_TYPE(type))
+		{
+		case VM_ANON:
+			page_initializer = anon_initializer;
+			break;
+		case VM_FILE:
+			page_initializer = file_backed_initializer;
+			break;
+		default:
+			kmem_cache_free(page_cachep, page);
+			goto err;
+			break;
+		}
+
+		uninit_new(page, upage, init, type, aux, page_initializer);
+		page->writable=writable;
+		page->owner=thread_current();
+		/* TODO: 생성한 페이지를 spt에 삽입하세요. */
+		if (!spt_insert_page(spt, page))
+		{
+		   // 실패 시 메모리 누수 방지 위해 free
+		   kmem_cache_free(page_cachep, page);
+		   // 실패 했으니까 에러로 가야겠지?
+		   goto err;
+		}
+  
+		return true;
+		
+	}
+err:
+	return false;
+}
+
+/* Find VA from spt and return page. On error, return NULL. */
+/* 가상 주소를 통해 SPT에서 페이지를 찾아 리턴합니다.
+ * 에러가 발생하면 NULL을 리턴하세요 */
+struct page *
+spt_find_page(struct supplemental_page_table *spt, void *va)
+{
+    ASSERT(spt != NULL);
+    // ASSERT(va != NULL);
+	if(va==NULL) return NULL;
+
+	struct page temp;
+	temp.va = pg_round_down(va);
+	
+	struct hash_elem *e = hash_find(&spt->spt_hash, &temp.hash_elem);
+	
+	if (e == NULL)
+		return NULL;
+	else
+		return hash_entry(e, struct page, hash_elem);
+	
+}
+
+
+/* Insert PAGE into spt with validation. */
+bool spt_insert_page(struct supplemental_page_table *spt,
+					 struct page *page)
+{
+	int succ = false;
+	ASSERT(page!=NULL);
+	struct hash_elem * e=hash_insert(&spt->spt_hash, &page->hash_elem);
+	if(e!=NULL) return succ; //실패했음
+
+	succ=true;
+	return succ;
+}
+
+void spt_remove_page(struct supplemental_page_table *spt, struct page *page)
+{
+	hash_delete(&spt->spt_hash, &page->hash_elem);	
+	// vm_dealloc_page(page); //<< 이거 쓰면 swap out~->swap in이 안될 것 같은데? 
+
+}
+
+/* [START, END)에 SPT 페이지가 하나라도 있으면 true를 반환합니다.
+ * 구간의 페이지 수와 SPT에 든 페이지 수 중 작은 쪽만큼만 살펴보므로,
+ * 큰 구간을 검사해도 이미 있는 페이지 수보다 오래 걸리지 않습니다. */
+bool spt_range_used(struct supplemental_page_table *spt, void *start, void *end)
+{
+	ASSERT(pg_ofs(start) == 0 && pg_ofs(end) == 0);
+
+	if ((size_t)(end - start) / PGSIZE <= hash_size(&spt->spt_hash))
+	{
+		for (void *va = start; va < end; va += PGSIZE)
+			if (spt_find_page(spt, va) != NULL)
+				return true;
+		return false;
+	}
+
+	struct hash_iterator i;
+	hash_first(&i, &spt->spt_hash);
+	while (hash_next(&i))
+	{
+		struct page *page = hash_entry(hash_cur(&i), struct page, hash_elem);
+		if (page->va >= start && page->va < end)
+			return true;
+	}
+	return false;
+}
+
+/* FRAME의 rmap에 PAGE 매핑을 추가합니다. frame_lock을 잡고 호출해야 합니다. */
+static void
+frame_map_page(struct frame *frame, struct page *page)
+{
+	ASSERT(lock_held_by_current_thread(&frame_table->frame_lock));
+
+	list_push_back(&frame->rmap, &page->rmap_elem);
+	page->frame = frame;
+	frame->r_cnt++;
+	if (frame->page == NULL)
+		frame->page = page;
+	if (frame != &zero_frame)
+		page->owner->spt.rss++;
+}
+
+/* FRAME의 rmap에서 PAGE 매핑을 뺍니다. 대표 매핑이 빠지면 다음 매핑이 대표가 됩니다. */
+static void
+frame_unmap_page(struct frame *frame, struct page *page)
+{
+	ASSERT(lock_held_by_current_thread(&frame_table->frame_lock));
+	ASSERT(page->frame == frame);
+
+	list_remove(&page->rmap_elem);
+	page->frame = NULL;
+	frame->r_cnt--;
+	if (frame != &zero_frame)
+		page->owner->spt.rss--;
+	if (frame->page == page)
+		frame->page = list_empty(&frame->rmap) ? NULL
+					: list_entry(list_front(&frame->rmap), struct page, rmap_elem);
+}
+
+/* 프레임을 매핑한 PTE 중 하나라도 accessed 비트가 켜져 있거나 샘플러가 옮겨 둔 비트가 있으면 true를 반환합니다. */
+static bool
+frame_is_accessed(struct frame *frame)
+{
+	struct list_elem *e;
+	if (frame->referenced)
+		return true;
+	for (e = list_begin(&frame->rmap); e != list_end(&frame->rmap); e = list_next(e))
+	{
+		struct page *page = list_entry(e, struct page, rmap_elem);
+		if (pml4_is_accessed(page->owner->pml4, page->va))
+			return true;
+	}
+	return false;
+}
+
+/* 프레임을 매핑한 모든 PTE의 accessed 비트를 지웁니다. (second chance) */
+static void
+frame_clear_accessed(struct frame *frame)
+{
+	struct list_elem *e;
+	frame->referenced = false;
+	for (e = list_begin(&frame->rmap); e != list_end(&frame->rmap); e = list_next(e))
+	{
+		struct page *page = list_entry(e, struct page, rmap_elem);
+		pml4_set_accessed(page->owner->pml4, page->va, false);
+	}
+}
+
+/* 프레임을 매핑한 PTE 중 하나라도 dirty 비트가 켜져 있으면 true를 반환합니다. */
+static bool
+frame_is_dirty(struct frame *frame)
+{
+	struct list_elem *e;
+	for (e = list_begin(&frame->rmap); e != list_end(&frame->rmap); e = list_next(e))
+	{
+		struct page *page = list_entry(e, struct page, rmap_elem);
+		if (pml4_is_dirty(page->owner->pml4, page->va))
+			return true;
+	}
+	return false;
+}
+
+/* 교체할 때 디스크 쓰기가 필요한 프레임이면 true를 반환합니다.
+ * 매핑 중 하나라도 dirty면 써야 하고, 깨끗하더라도 실행 파일 원본이 없는 익명 페이지는
+ * 스왑 디스크 말고는 사본이 없으므로 써야 합니다. */
+static bool
+frame_needs_writeback(struct frame *frame)
+{
+	struct list_elem *e;
+
+	if (frame_is_dirty(frame))
+		return true;
+	for (e = list_begin(&frame->rmap); e != list_end(&frame->rmap); e = list_next(e))
+	{
+		struct page *page = list_entry(e, struct page, rmap_elem);
+		if (VM_TYPE(page->operations->type) == VM_ANON && page->anon.backing == NULL)
+			return true;
+	}
+	return false;
+}
+
+/* 교체 후보가 될 수 있는 프레임인지 확인합니다.
+ * 초기화 중(pinned)인 프레임은 건너뜁니다. 공유 중인 프레임도 rmap으로 모든 매핑을 끊을 수 있습니다. */
+static bool
+frame_is_evictable(struct frame *frame)
+{
+	return frame->page != NULL && !frame->pinned;
+}
+
+/* 프로세스 T가 working set보다 많은 프레임을 들고 있거나 상주 집합 제한을 넘었으면 true를 반환합니다. */
+static bool
+owner_is_over(struct thread *t)
+{
+	struct supplemental_page_table *spt = &t->spt;
+
+	if (vm_rss_limit != 0 && spt->rss > vm_rss_limit)
+		return true;
+	/* 한 번도 샘플하지 않은 프로세스는 working set을 모르므로 넘지 않은 것으로 봅니다. */
+	return ws_running && spt->ws_gen != 0 && spt->rss > spt->ws_size;
+}
+
+/* FRAME이 이번 교체 라운드의 후보인지 확인합니다.
+ * OWNER가 있으면 OWNER만 매핑한 프레임, PREFER면 모든 매핑의 소유자가 owner_is_over()인 프레임만 받습니다. */
+static bool
+frame_in_scope(struct frame *frame, struct thread *owner, bool prefer)
+{
+	struct list_elem *e;
+
+	if (owner == NULL && !prefer)
+		return true;
+	for (e = list_begin(&frame->rmap); e != list_end(&frame->rmap); e = list_next(e))
+	{
+		struct page *page = list_entry(e, struct page, rmap_elem);
+		if (owner != NULL && page->owner != owner)
+			return false;
+		if (prefer && !owner_is_over(page->owner))
+			return false;
+	}
+	return true;
+}
+
+/* clock 바늘이 가리키는 프레임을 반환하고 바늘을 한 칸 전진시킵니다.
+ * 리스트 끝에 도달하면 처음으로 되돌아갑니다. */
+static struct frame *
+clock_advance(void)
+{
+	struct list *frames = &frame_table->frame_list;
+
+	if (frame_table->clock_hand == NULL || frame_table->clock_hand == list_end(frames))
+		frame_table->clock_hand = list_begin(frames);
+
+	struct frame *frame = list_entry(frame_table->clock_hand, struct frame, frame_elem);
+	frame_table->clock_hand = list_next(frame_table->clock_hand);
+	return frame;
+}
+
+/* Get the struct frame, that will be evicted. */
+/* enhanced clock(second chance) 교체 정책입니다.
+ * 짝수 번째 바퀴에서는 (accessed=0, clean) 프레임만 고르고 비트는 건드리지 않습니다.
+ * 홀수 번째 바퀴에서는 dirty 프레임도 받아들이고, 지나가는 프레임의 accessed 비트를 지웁니다.
+ * working set을 넘은 프로세스가 있으면 처음 두 바퀴는 그 프로세스들의 프레임만 봅니다.
+ * OWNER가 주어지면 OWNER만 매핑한 프레임 중에서 고릅니다.
+ * 네 바퀴 안에 교체 가능한 프레임이 하나라도 있으면 반드시 찾게 됩니다. */
+static struct frame *
+vm_get_victim(struct thread *owner)
+{
+	ASSERT(lock_held_by_current_thread(&frame_table->frame_lock));
+	ASSERT(list_empty(&frame_table->frame_list)==false);
+
+	size_t frame_cnt = list_size(&frame_table->frame_list);
+	int first = owner == NULL && ws_over_cnt > 0 ? -2 : 0;
+
+	for (int pass = first; pass < 4; pass++)
+	{
+		bool accept_dirty = pass % 2 != 0;
+		bool prefer = pass < 0;
+
+		for (size_t i = 0; i < frame_cnt; i++)
+		{
+			struct frame *frame = clock_advance();
+			if (!frame_is_evictable(frame) || !frame_in_scope(frame, owner, prefer))
+				continue;
+
+			if (frame_is_accessed(frame))
+			{
+				if (accept_dirty)
+					frame_clear_accessed(frame);
+				continue;
+			}
+
+			if (accept_dirty || !frame_needs_writeback(frame))
+				return frame;
+		}
+	}
+	return NULL;
+}
+
+/* 교체에 실패했을 때 FRAME의 모든 매핑을 되살립니다.
+ * 공유 중인 프레임은 읽기 전용으로 되돌리고, write-back 판단을 위해 dirty 비트는 유지합니다. */
+static void
+frame_restore_mappings(struct frame *frame)
+{
+	struct list_elem *e;
+	for (e = list_begin(&frame->rmap); e != list_end(&frame->rmap); e = list_next(e))
+	{
+		struct page *page = list_entry(e, struct page, rmap_elem);
+		uint64_t *pml4 = page->owner->pml4;
+		bool dirty = pml4_is_dirty(pml4, page->va);
+
+		pml4_set_page(pml4, page->va, frame->kva, page->writable && frame->r_cnt == 1);
+		pml4_set_dirty(pml4, page->va, dirty);
+	}
+}
+
+/* 한 페이지를 교체(evict)하고 해당 프레임을 반환합니다.
+ * OWNER가 주어지면 OWNER만 매핑한 프레임을 내보냅니다.
+ * rmap을 따라 이 프레임을 매핑한 모든 프로세스의 PTE를 끊습니다.
+ * 익명 매핑들은 스왑 슬롯 하나를 함께 쓰고, 파일 매핑은 각자 dirty면 write-back 합니다.
+ * 깨끗한 실행 파일 페이지는 스왑에 쓰지 않고 버립니다. 다음 fault에 파일에서 다시 읽습니다.
+ * 스왑·write-back I/O 동안에는 frame_lock을 놓습니다. write-back은 filesys_lock을 잡으므로,
+ * 락을 쥔 채 I/O를 하면 filesys_lock을 쥐고 폴트를 낸 스레드와 서로 기다리게 됩니다.
+ * frame_lock을 잡은 상태에서 호출해야 하며, 반환된 프레임은 pinned 상태입니다. 에러가 발생하면 NULL을 반환합니다.*/
+static struct frame *
+vm_evict_frame(struct thread *owner)
+{
+	ASSERT(lock_held_by_current_thread(&frame_table->frame_lock));
+
+	struct frame *victim  = vm_get_victim(owner);
+	if(victim==NULL) return NULL;	
+
+	struct list_elem *e;
+	struct page *anon_src = NULL;
+
+	/* 내보내는 동안 소유자들이 쓰지 못하도록 매핑을 먼저 끊습니다.
+	 * pml4_clear_page는 present 비트만 지우므로 swap_out에서 dirty 비트를 그대로 볼 수 있습니다. */
+	for (e = list_begin(&victim->rmap); e != list_end(&victim->rmap); e = list_next(e))
+	{
+		struct page *page = list_entry(e, struct page, rmap_elem);
+		pml4_clear_page(page->owner->pml4, page->va);
+	}
+
+	/* 한 번이라도 쓰인 내용은 실행 파일과 달라졌으므로 원본 정보를 버리고 스왑으로 보냅니다. */
+	bool dirty = frame_is_dirty(victim);
+	for (e = list_begin(&victim->rmap); e != list_end(&victim->rmap); e = list_next(e))
+	{
+		struct page *page = list_entry(e, struct page, rmap_elem);
+		if (VM_TYPE(page->operations->type) != VM_ANON)
+			continue;
+		if (dirty)
+			anon_drop_backing(page);
+		if (anon_src == NULL && page->anon.backing == NULL)
+			anon_src = page;
+	}
+
+	/* 락을 놓는 동안 다른 스레드가 이 프레임을 새로 매핑하거나 다시 고르지 않게 합니다.
+	 * rmap을 바꾸려는 스레드는 page_wait_evict()에서 교체가 끝나기를 기다립니다. */
+	share_table_remove(victim);
+	ksm_forget(victim);
+	victim->pinned = true;
+	victim->evicting = true;
+	lock_release(&frame_table->frame_lock);
+
+	/* 실패할 수 있는 스왑 쓰기를 가장 먼저 해서, 실패하면 아무것도 바꾸지 않고 되돌립니다. */
+	bool succ = anon_src == NULL || swap_out(anon_src);
+	if (succ)
+		for (e = list_begin(&victim->rmap); e != list_end(&victim->rmap); e = list_next(e))
+		{
+			struct page *page = list_entry(e, struct page, rmap_elem);
+			if (page == anon_src)
+				continue;
+			if (VM_TYPE(page->operations->type) == VM_ANON)
+			{
+				if (page->anon.backing == NULL)
+					anon_swap_share(page, anon_src);
+			}
+			else
+				swap_out(page);
+		}
+
+	lock_acquire(&frame_table->frame_lock);
+	victim->evicting = false;
+	cond_broadcast(&evict_cond, &frame_table->frame_lock);
+	if (!succ)
+	{
+		frame_restore_mappings(victim);
+		victim->pinned = false;
+		return NULL;
+	}
+
+	/* 연결 해제 */
+	while (!list_empty(&victim->rmap))
+		frame_unmap_page(victim, list_entry(list_front(&victim->rmap), struct page, rmap_elem));
+	ASSERT(victim->page == NULL && victim->r_cnt == 0);
+	victim->ksm_checksum = 0;
+	victim->referenced = false;
+	return victim;
+}
+
+/* 새 프레임을 clock 바늘 바로 앞에 넣어서 한 바퀴가 지난 뒤에 검사되도록 합니다. */
+static void
+frame_table_insert(struct frame *frame)
+{
+	struct list_elem *hand = frame_table->clock_hand;
+
+	if (hand == NULL || hand == list_end(&frame_table->frame_list))
+		list_push_back(&frame_table->frame_list, &frame->frame_elem);
+	else
+		list_insert(hand, &frame->frame_elem);
+}
+
+/* palloc()을 사용하여 프레임을 할당합니다.
+ * 사용 가능한 페이지가 없으면 페이지를 교체(evict)하여 반환합니다.
+ * 현재 프로세스가 상주 집합 제한에 닿았으면 자기 프레임 하나를 내보내 재사용합니다.
+ * 교체할 프레임도 없으면 OOM 킬러가 다른 프로세스를 끝내기를 기다리는 동안 frame_lock을 잠시 놓으며,
+ * 그래도 메모리를 얻지 못하면 NULL을 반환합니다.
+ * frame_lock을 잡은 상태에서 호출해야 하며, 반환된 프레임은 pinned 상태입니다. */
+static struct frame *
+vm_get_frame(void)
+{
+	ASSERT(lock_held_by_current_thread(&frame_table->frame_lock));
+
+	struct thread *cur = thread_current();
+	if (vm_rss_limit != 0 && cur->pml4 != NULL && cur->spt.rss >= vm_rss_limit)
+	{
+		struct frame *victim = vm_evict_frame(cur);
+		if (victim != NULL)
+		{
+			memset(victim->kva, 0, PGSIZE);
+			return victim;
+		}
+	}
+
+	for (int tries = 0; ; tries++)
+	{
+		void *kva = palloc_get_page(PAL_USER | PAL_ZERO);
+
+		pageout_poke();
+
+		if (kva != NULL)
+			return frame_create(kva);
+
+		/* 데몬이 따라잡지 못한 경우에만 fault 경로에서 직접 교체합니다. */
+		/* 희생 프레임은 테이블에 그대로 두고 구조체째 재사용합니다. */
+		struct frame * victim=vm_evict_frame(NULL); //이 안에서 swap out
+		if (victim != NULL)
+		{
+			memset(victim->kva, 0, PGSIZE);
+			return victim;
+		}
+
+		if (tries == OOM_RETRIES || !oom_kill())
+			return NULL;
+	}
+}
+
+/* oom_kill()이 thread_foreach()로 고른 희생자 */
+struct oom_pick
+{
+	struct thread *victim;
+	size_t score;
+	bool pending; /* 이미 종료를 요청받고 아직 끝나지 않은 프로세스가 있음 */
+};
+
+/* 유저 프로세스 T의 점수(상주 프레임 + 스왑 슬롯)를 보고 가장 큰 프로세스를 PICK에 남깁니다. */
+static void
+oom_score(struct thread *t, void *aux)
+{
+	struct oom_pick *pick = aux;
+
+	if (t->pml4 == NULL || t->status == THREAD_DYING)
+		return;
+	if (t->killed)
+	{
+		pick->pending = true;
+		return;
+	}
+	/* 커널 안에서 잠든 프로세스(wait, timer_sleep 등)는 유저 모드로 돌아갈 때까지
+	 * 종료 요청을 보지 못해 프레임을 돌려주지 않으므로 고르지 않습니다. */
+	if (t->status == THREAD_BLOCKED)
+		return;
+
+	size_t score = t->spt.rss + t->spt.swap_cnt;
+	if (pick->victim == NULL || score > pick->score)
+	{
+		pick->victim = t;
+		pick->score = score;
+	}
+}
+
+/* 가장 큰 유저 프로세스에 종료를 요청하고, frame_lock을 놓은 채 잠시 기다립니다.
+ * 이미 요청받은 프로세스가 있으면 새로 고르지 않고 그 프로세스가 끝나기를 기다립니다.
+ * 다시 할당해 볼 만하면 true를, 고를 프로세스가 없거나 현재 프로세스가 선택되었으면 false를 반환합니다.
+ * frame_lock을 잡은 상태에서 호출해야 합니다. */
+static bool
+oom_kill(void)
+{
+	struct thread *cur = thread_current();
+	struct oom_pick pick = {NULL, 0, false};
+	enum intr_level old_level;
+
+	old_level = intr_disable();
+	thread_foreach(oom_score, &pick);
+	if (!pick.pending && pick.victim != NULL)
+		pick.victim->killed = true;
+	intr_set_level(old_level);
+
+	if (!pick.pending)
+	{
+		if (pick.victim == NULL)
+			return false;
+		printf("Out of memory: killed process %s\n", pick.victim->name);
+	}
+	/* mem_notify()에서 잠들어 자기 프레임을 돌려줄 수 있는 프로그램을 깨웁니다. */
+	cond_broadcast(&lowmem_cond, &frame_table->frame_lock);
+	if (cur->killed)
+		return false;
+
+	lock_release(&frame_table->frame_lock);
+	timer_sleep(OOM_WAIT_TICKS);
+	lock_acquire(&frame_table->frame_lock);
+	return !cur->killed;
+}
+
+/* 다음번에 메모리가 부족해질 때까지 기다렸다가 그때의 빈 유저 페이지 수를 반환합니다. */
+int
+vm_mem_notify(void)
+{
+	lock_acquire(&frame_table->frame_lock);
+	cond_wait(&lowmem_cond, &frame_table->frame_lock);
+	int free_cnt = palloc_user_free_pages();
+	lock_release(&frame_table->frame_lock);
+	return free_cnt;
+}
+
+/* 유저 풀 페이지 KVA를 담는 프레임 구조체를 만들어 프레임 테이블에 넣습니다.
+ * frame_lock을 잡은 상태에서 호출해야 하며, 반환된 프레임은 pinned 상태입니다. */
+static struct frame *
+frame_create(void *kva)
+{
+	struct frame *frame = kmem_cache_alloc(frame_cachep);
+	ASSERT(frame!=NULL);
+	frame->kva = kva;
+	frame->page=NULL;
+	frame->r_cnt=0;
+	frame->pinned = true;
+	frame->evicting = false;
+	frame->shared_ro = false;
+	frame->ksm_checksum = 0;
+	frame->ksm_listed = false;
+	frame->referenced = false;
+
+	frame_table_insert(frame);
+	
+	ASSERT(frame != NULL);
+	ASSERT(frame->page == NULL);
+	ASSERT(frame->kva!=NULL);
+	return frame;
+}
+
+/* FRAME을 프레임 테이블에서 빼고 물리 페이지와 함께 해제합니다. */
+void
+vm_free_frame(struct frame *frame)
+{
+	bool held = lock_held_by_current_thread(&frame_table->frame_lock);
+
+	if (!held)
+		lock_acquire(&frame_table->frame_lock);
+	if (frame_table->clock_hand == &frame->frame_elem)
+		frame_table->clock_hand = list_next(&frame->frame_elem);
+	if (frame_table->ksm_hand == &frame->frame_elem)
+		frame_table->ksm_hand = list_next(&frame->frame_elem);
+	ASSERT(list_empty(&frame->rmap));
+	list_remove(&frame->frame_elem);
+	share_table_remove(frame);
+	ksm_forget(frame);
+	if (!held)
+		lock_release(&frame_table->frame_lock);
+
+	palloc_free_page(frame->kva);
+	kmem_cache_free(frame_cachep, frame);
+}
+
+/* frame 캐시의 생성자입니다. 해제된 프레임의 rmap은 항상 비어 있으므로 슬랩을 만들 때 한 번만 초기화하면 됩니다. */
+static void
+frame_ctor(void *obj)
+{
+	struct frame *frame = obj;
+	list_init(&frame->rmap);
+}
+
+/* 여유 프레임이 적으면 데몬을 깨워서 다음 fault가 디스크 I/O 없이 끝나도록 합니다.
+ * frame_lock을 잡은 상태에서 호출해야 합니다. */
+static void
+pageout_poke(void)
+{
+	if (!pageout_requested && palloc_user_free_pages() < vm_low_watermark) {
+		pageout_requested = true;
+		sema_up(&pageout_sema);
+		cond_broadcast(&lowmem_cond, &frame_table->frame_lock);
+	}
+}
+
+/* pageout 데몬 본체입니다.
+ * 깨어나면 빈 페이지가 high 워터마크에 닿을 때까지 한 프레임씩 내보내고 풀에 돌려줍니다.
+ * 프레임 하나마다 frame_lock을 놓고, 교체 I/O 동안에도 놓아서 그 사이에 fault 처리가 끼어들 수 있게 합니다. */
+static void
+pageout_daemon(void *aux UNUSED)
+{
+	for (;;)
+	{
+		sema_down(&pageout_sema);
+
+		while (palloc_user_free_pages() < vm_high_watermark)
+		{
+			lock_acquire(&frame_table->frame_lock);
+			struct frame *victim = vm_evict_frame(NULL);
+			if (victim != NULL)
+				vm_free_frame(victim);
+			lock_release(&frame_table->frame_lock);
+
+			if (victim == NULL)
+				break;
+		}
+
+		lock_acquire(&frame_table->frame_lock);
+		pageout_requested = false;
+		lock_release(&frame_table->frame_lock);
+	}
+}
+
+/* 워터마크 기본값을 정하고 pageout 데몬을 띄웁니다.
+ * 커맨드라인(-wl, -wh)으로 주지 않았다면 유저 풀의 1/32을 low, 그 두 배를 high로 씁니다. */
+static void
+pageout_init(void)
+{
+	if (vm_low_watermark == 0)
+		vm_low_watermark = palloc_user_pages() / 32;
+	if (vm_high_watermark == 0)
+		vm_high_watermark = vm_low_watermark * 2;
+	if (vm_high_watermark < vm_low_watermark)
+		vm_high_watermark = vm_low_watermark;
+
+	sema_init(&pageout_sema, 0);
+	cond_init(&lowmem_cond);
+	pageout_requested = false;
+	if (vm_low_watermark > 0)
+		thread_create("pageoutd", PRI_DEFAULT, pageout_daemon, NULL);
+}
+
+static uint64_t
+ksm_hash(const struct hash_elem *e, void *aux UNUSED)
+{
+	return hash_entry(e, struct frame, ksm_elem)->ksm_checksum;
+}
+
+static bool
+ksm_less(const struct hash_elem *a, const struct hash_elem *b, void *aux UNUSED)
+{
+	return hash_entry(a, struct frame, ksm_elem)->ksm_checksum <
+		   hash_entry(b, struct frame, ksm_elem)->ksm_checksum;
+}
+
+/* FRAME이 후보 테이블에 있으면 뺍니다. frame_lock을 잡고 호출해야 합니다. */
+static void
+ksm_forget(struct frame *frame)
+{
+	if (frame->ksm_listed)
+	{
+		hash_delete(&ksm_table, &frame->ksm_elem);
+		frame->ksm_listed = false;
+	}
+}
+
+/* hash_clear() 콜백: 후보 표시를 지웁니다. */
+static void
+ksm_unlist(struct hash_elem *e, void *aux UNUSED)
+{
+	hash_entry(e, struct frame, ksm_elem)->ksm_listed = false;
+}
+
+/* 합칠 수 있는 프레임인지 확인합니다.
+ * 다 채워진 프레임이어야 하고, 모든 매핑이 익명 페이지이며 파일 공유 프레임이 아니어야 합니다. */
+static bool
+ksm_frame_mergeable(struct frame *frame)
+{
+	struct list_elem *e;
+
+	if (frame->page == NULL || frame->pinned || frame->shared_ro)
+		return false;
+	for (e = list_begin(&frame->rmap); e != list_end(&frame->rmap); e = list_next(e))
+	{
+		struct page *page = list_entry(e, struct page, rmap_elem);
+		if (VM_TYPE(page->operations->type) != VM_ANON)
+			return false;
+	}
+	return true;
+}
+
+/* FRAME의 모든 매핑을 읽기 전용으로 바꿉니다. dirty 비트는 유지합니다. */
+static void
+ksm_write_protect(struct frame *frame)
+{
+	struct list_elem *e;
+	for (e = list_begin(&frame->rmap); e != list_end(&frame->rmap); e = list_next(e))
+	{
+		struct page *page = list_entry(e, struct page, rmap_elem);
+		uint64_t *pml4 = page->owner->pml4;
+		bool dirty = pml4_is_dirty(pml4, page->va);
+
+		pml4_set_page(pml4, page->va, frame->kva, false);
+		pml4_set_dirty(pml4, page->va, dirty);
+	}
+}
+
+/* DUP의 매핑을 모두 KEEP으로 옮기고 DUP을 해제합니다.
+ * 먼저 양쪽을 쓰기 금지한 뒤 내용을 비교하므로, 비교 후에 내용이 바뀔 수 없습니다.
+ * 내용이 다르면 false를 반환합니다. 쓰기 금지는 다음 쓰기 폴트에서 그냥 풀립니다. */
+static bool
+ksm_merge(struct frame *keep, struct frame *dup)
+{
+	ksm_write_protect(keep);
+	ksm_write_protect(dup);
+	if (memcmp(keep->kva, dup->kva, PGSIZE) != 0)
+		return false;
+
+	while (!list_empty(&dup->rmap))
+	{
+		struct page *page = list_entry(list_front(&dup->rmap), struct page, rmap_elem);
+		uint64_t *pml4 = page->owner->pml4;
+		bool dirty = pml4_is_dirty(pml4, page->va);
+
+		frame_unmap_page(dup, page);
+		frame_map_page(keep, page);
+		pml4_set_page(pml4, page->va, keep->kva, false);
+		pml4_set_dirty(pml4, page->va, dirty);
+	}
+	vm_free_frame(dup);
+	ksm_merged++;
+	return true;
+}
+
+/* 프레임 하나를 검사합니다. 내용이 그대로인 프레임은 같은 해시의 후보와 합치거나 후보로 올립니다. */
+static void
+ksm_scan_frame(struct frame *frame)
+{
+	ksm_scanned++;
+	if (!ksm_frame_mergeable(frame))
+		return;
+
+	unsigned checksum = hash_bytes(frame->kva, PGSIZE);
+	if (checksum != frame->ksm_checksum)
+	{
+		/* 지난번과 내용이 다르면 자주 쓰이는 페이지로 보고 다음 바퀴까지 미룹니다. */
+		ksm_forget(frame);
+		frame->ksm_checksum = checksum;
+		return;
+	}
+	if (frame->ksm_listed)
+		return;
+
+	struct hash_elem *e = hash_find(&ksm_table, &frame->ksm_elem);
+	if (e != NULL)
+	{
+		struct frame *keep = hash_entry(e, struct frame, ksm_elem);
+		if (ksm_frame_mergeable(keep) && ksm_merge(keep, frame))
+			return;
+		/* 해시만 같았거나 그 사이에 바뀐 후보는 이 프레임으로 바꿉니다. */
+		ksm_forget(keep);
+	}
+	hash_insert(&ksm_table, &frame->ksm_elem);
+	frame->ksm_listed = true;
+}
+
+/* KSM 스캐너 본체입니다.
+ * KSM_SLEEP_TICKS마다 깨어나 vm_ksm_scan_pages개 프레임을 검사합니다.
+ * 프레임을 해제할 수 있으므로 다음 프레임을 먼저 구해 두고 검사합니다. */
+static void
+ksm_daemon(void *aux UNUSED)
+{
+	struct list *frames = &frame_table->frame_list;
+
+	for (;;)
+	{
+		timer_sleep(KSM_SLEEP_TICKS);
+
+		lock_acquire(&frame_table->frame_lock);
+		for (size_t i = 0; i < vm_ksm_scan_pages && !list_empty(frames); i++)
+		{
+			if (frame_table->ksm_hand == NULL || frame_table->ksm_hand == list_end(frames))
+			{
+				/* 한 바퀴를 다 돌았으면 후보 테이블을 새로 만듭니다. */
+				frame_table->ksm_hand = list_begin(frames);
+				hash_clear(&ksm_table, ksm_unlist);
+				ksm_passes++;
+			}
+			struct frame *frame = list_entry(frame_table->ksm_hand, struct frame, frame_elem);
+			frame_table->ksm_hand = list_next(frame_table->ksm_hand);
+			ksm_scan_frame(frame);
+		}
+		lock_release(&frame_table->frame_lock);
+	}
+}
+
+/* KSM 스캐너를 띄웁니다. MLFQS 테스트의 load_avg를 흐리지 않도록 -mlfqs에서는 띄우지 않습니다. */
+static void
+ksm_init(void)
+{
+	if (vm_ksm_scan_pages > 0 && !thread_mlfqs)
+		thread_create("ksmd", PRI_MIN, ksm_daemon, NULL);
+}
+
+/* 프레임 하나의 accessed 비트를 소유자별 ws_cur에 더하고 frame->referenced로 옮깁니다.
+ * 이번 구간에 처음 보는 소유자는 지난 구간의 수를 ws_size로 넘기고 새로 셉니다. */
+static void
+ws_sample_frame(struct frame *frame)
+{
+	struct list_elem *e;
+
+	for (e = list_begin(&frame->rmap); e != list_end(&frame->rmap); e = list_next(e))
+	{
+		struct page *page = list_entry(e, struct page, rmap_elem);
+		struct supplemental_page_table *spt = &page->owner->spt;
+
+		if (spt->ws_gen != ws_gen)
+		{
+			/* 처음 샘플하는 프로세스는 지금 들고 있는 프레임을 모두 working set으로 봅니다. */
+			spt->ws_size = spt->ws_gen == 0 ? spt->rss : spt->ws_cur;
+			spt->ws_cur = 0;
+			spt->ws_gen = ws_gen;
+			if (spt->rss > spt->ws_size)
+				ws_over_cnt++;
+		}
+		if (pml4_is_accessed(page->owner->pml4, page->va))
+		{
+			spt->ws_cur++;
+			frame->referenced = true;
+			pml4_set_accessed(page->owner->pml4, page->va, false);
+		}
+	}
+}
+
+/* working set 샘플러 본체입니다. vm_ws_ticks마다 깨어나 프레임 테이블 전체를 한 번 훑습니다. */
+static void
+ws_daemon(void *aux UNUSED)
+{
+	struct list *frames = &frame_table->frame_list;
+	struct list_elem *e;
+
+	for (;;)
+	{
+		timer_sleep(vm_ws_ticks);
+
+		lock_acquire(&frame_table->frame_lock);
+		ws_gen++;
+		ws_over_cnt = 0;
+		for (e = list_begin(frames); e != list_end(frames); e = list_next(e))
+		{
+			struct frame *frame = list_entry(e, struct frame, frame_elem);
+			if (!frame->pinned)
+				ws_sample_frame(frame);
+		}
+		lock_release(&frame_table->frame_lock);
+	}
+}
+
+/* working set 샘플러를 띄웁니다. ksmd와 같은 이유로 -mlfqs에서는 띄우지 않습니다. */
+static void
+ws_init(void)
+{
+	if (vm_ws_ticks > 0 && !thread_mlfqs)
+	{
+		ws_running = true;
+		thread_create("wsd", PRI_MIN, ws_daemon, NULL);
+	}
+}
+
+/* KSM과 큰 페이지 통계를 출력합니다. */
+void
+vm_ksm_print_stats(void)
+{
+	printf("KSM: %zu frames scanned in %zu passes, %zu frames merged\n",
+		   ksm_scanned, ksm_passes, ksm_merged);
+	if (vm_large_pages)
+		printf("Large pages: %zu mapped\n", vm_large_cnt);
+}
+
+/* PAGE의 프레임이 교체 I/O 중이면 끝날 때까지 기다립니다. 교체가 끝나면 PAGE는 프레임을 잃거나(성공)
+ * 원래 매핑을 되찾습니다(실패). frame_lock을 잡은 상태에서 호출해야 하며, 기다리는 동안 락을 놓습니다. */
+static void
+page_wait_evict(struct page *page)
+{
+	ASSERT(lock_held_by_current_thread(&frame_table->frame_lock));
+
+	while (page->frame != NULL && page->frame->evicting)
+		cond_wait(&evict_cond, &frame_table->frame_lock);
+}
+
+/* PAGE가 잡고 있던 프레임 참조를 놓습니다.
+ * 마지막 참조였다면 프레임을 해제하고, 아직 다른 페이지가 공유 중이면 그대로 둡니다. */
+void
+vm_frame_unref(struct page *page)
+{
+	struct frame *frame = page->frame;
+	if (frame == NULL)
+		return;
+
+	lock_acquire(&frame_table->frame_lock);
+	/* 락을 기다리는 사이 교체되었을 수 있으므로 다시 확인합니다. */
+	page_wait_evict(page);
+	frame = page->frame;
+	if (frame != NULL)
+	{
+		/* 락을 잡은 채로 PTE를 지워야, rmap을 따라 PTE를 고치는 KSM이나 교체 코드가
+		 * 이미 지운 매핑을 되살려 놓는 일이 없습니다. */
+		pml4_clear_page(page->owner->pml4, page->va);
+		frame_unmap_page(frame, page);
+		if (frame->r_cnt == 0 && frame != &zero_frame)
+			vm_free_frame(frame);
+	}
+	lock_release(&frame_table->frame_lock);
+}
+
+/* zero 프레임을 커널 풀에서 할당합니다. */
+static void
+zero_frame_init(void)
+{
+	zero_frame.kva = palloc_get_page(PAL_ASSERT | PAL_ZERO);
+	zero_frame.page = NULL;
+	list_init(&zero_frame.rmap);
+	zero_frame.r_cnt = 0;
+	zero_frame.pinned = true;
+	zero_frame.evicting = false;
+	zero_frame.shared_ro = false;
+}
+
+/* 첫 접근 때 0으로만 채워질 익명 페이지면 true를 반환합니다.
+ * 스택 성장처럼 init이 없는 페이지와, 파일에서 읽을 내용이 없는 BSS 페이지가 해당됩니다. */
+static bool
+page_is_zero_fill(struct page *page)
+{
+	if (VM_TYPE(page->operations->type) != VM_UNINIT || VM_TYPE(page->uninit.type) != VM_ANON)
+		return false;
+	if (page->uninit.init == NULL)
+		return true;
+	if (page->uninit.init == lazy_load_segment)
+	{
+		struct file_info *info = page->uninit.aux;
+		return info != NULL && info->read_bytes == 0;
 	}
+	return false;
 }
 
-void frame_table_init(){
-	frame_table = malloc(sizeof(struct frame_table));
-	list_init(&frame_table->frame_list);
+/* 읽기 폴트가 난 0 페이지를 zero 프레임에 읽기 전용으로 매핑합니다. 유저 풀 프레임을 쓰지 않습니다. */
+static bool
+vm_map_zero_page(struct page *page)
+{
+	lock_acquire(&frame_table->frame_lock);
+	if (!page_transmute(page, zero_frame.kva))
+	{
+		lock_release(&frame_table->frame_lock);
+		return false;
+	}
+	frame_map_page(&zero_frame, page);
+	if (!pml4_set_page(thread_current()->pml4, page->va, zero_frame.kva, false))
+	{
+		/* 페이지 테이블을 만들 커널 페이지가 없습니다. */
+		frame_unmap_page(&zero_frame, page);
+		lock_release(&frame_table->frame_lock);
+		return false;
+	}
+	lock_release(&frame_table->frame_lock);
+	return true;
 }
 
-/* Helpers */
-static struct frame *vm_get_victim(void);
-static bool vm_do_claim_page(struct page *page);
-static struct frame *vm_evict_frame(void);
-
-/* 초기화 함수와 함께 대기 중인 페이지 객체를 생성합니다. 페이지를 직접 생성하지 말고,
- * 반드시 이 함수나 `vm_alloc_page`를 통해 생성하세요. */
-bool vm_alloc_page_with_initializer(enum vm_type type, void *upage, bool writable,
-									vm_initializer *init, void *aux)
+/* VA를 포함하는 2MB 구간을 큰 페이지 하나로 올립니다.
+ * 구간의 512 페이지가 모두 쓰기 가능하고 아직 손대지 않은 0 페이지여야 합니다.
+ * SPT에 아직 없는 페이지는 구간을 통째로 덮는 쓰기 가능한 익명 VMA가 있을 때만 허용하고, 그 VMA에서 만듭니다.
+ * 정렬된 연속 물리 페이지를 얻지 못하면(조각화) false를 반환하고, 호출자는 4KB로 처리합니다.
+ * 각 4KB 조각은 보통 프레임처럼 프레임 테이블과 rmap에 올라가므로, 교체나 fork, munmap이
+ * 일부 페이지의 PTE를 고치면 mmu.c가 큰 페이지를 4KB로 쪼갭니다. */
+static bool
+vm_claim_large_page(void *va)
 {
+	struct thread *cur = thread_current();
+	uint8_t *base = (uint8_t *)((uint64_t)va & ~(LARGE_PGSIZE - 1));
+	struct vma *vma = vma_find(&cur->spt, base);
 
-	struct supplemental_page_table *spt = &thread_current()->spt;
-	ASSERT(spt!=NULL);
+	if (vma != NULL && (vma->file != NULL || !vma->writable || (uint8_t *)vma->end < base + LARGE_PGSIZE))
+		vma = NULL;
 
-	/* 이미 해당 page가 SPT에 존재하는지 확인합니다 */
-	if (spt_find_page(spt, upage) == NULL)
+	for (size_t i = 0; i < LARGE_PGCNT; i++)
 	{
-		/* TODO: VM 타입에 따라 페이지를 생성하고, 초기화 함수를 가져온 뒤,
-		 * TODO: uninit_new를 호출하여 "uninit" 페이지 구조체를 생성하세요.
-		 * TODO: uninit_new 호출 후에는 필요한 필드를 수정해야 합니다. */
-		bool (*page_initializer)(struct page *, enum vm_type, void *kva);
-		struct page *page = malloc(sizeof(struct page));
-		ASSERT(page!=NULL);
+		struct page *page = spt_find_page(&cur->spt, base + i * PGSIZE);
+		if (page == NULL ? vma == NULL
+						 : VM_TYPE(page->operations->type) != VM_UNINIT ||
+							   !page->writable || !page_is_zero_fill(page))
+			return false;
+	}
 
-		switch (VM_TYPE(type))
-		{
-		case VM_ANON:
-			page_initializer = anon_initializer;
-			break;
-		case VM_FILE:
-			page_initializer = file_backed_initializer;
-			break;
-		default:
-			free(page);
-			goto err;
-			break;
-		}
+	lock_acquire(&frame_table->frame_lock);
+	uint8_t *kva = palloc_get_aligned(PAL_USER | PAL_ZERO, LARGE_PGCNT);
+	pageout_poke();
+	if (kva == NULL)
+	{
+		lock_release(&frame_table->frame_lock);
+		return false;
+	}
 
-		uninit_new(page, upage, init, type, aux, page_initializer);
-		page->writable=writable;
-		/* TODO: 생성한 페이지를 spt에 삽입하세요. */
-		if (!spt_insert_page(spt, page))
+	/* 프레임을 얻은 뒤에야 VMA의 빈 자리에 페이지 구조체를 만듭니다. 만들다 실패하면 4KB로 처리합니다. */
+	for (size_t i = 0; i < LARGE_PGCNT; i++)
+		if (spt_find_page(&cur->spt, base + i * PGSIZE) == NULL &&
+			vma_materialize(vma, base + i * PGSIZE) == NULL)
 		{
-		   // 실패 시 메모리 누수 방지 위해 free
-		   free(page);
-		   // 실패 했으니까 에러로 가야겠지?
-		   goto err;
+			palloc_free_multiple(kva, LARGE_PGCNT);
+			lock_release(&frame_table->frame_lock);
+			return false;
 		}
-  
-		return true;
-		
+
+	for (size_t i = 0; i < LARGE_PGCNT; i++)
+	{
+		struct page *page = spt_find_page(&cur->spt, base + i * PGSIZE);
+		struct frame *frame = frame_create(kva + i * PGSIZE);
+		if (!page_transmute(page, frame->kva))
+			PANIC("large page: cannot initialize page");
+		frame_map_page(frame, page);
+		frame->pinned = false;
 	}
-err:
-	return false;
+
+	/* PDE를 바꿀 수 없으면 같은 프레임들을 4KB로 매핑합니다. */
+	if (!pml4_set_large_page(cur->pml4, base, kva, true))
+		for (size_t i = 0; i < LARGE_PGCNT; i++)
+			if (!pml4_set_page(cur->pml4, base + i * PGSIZE, kva + i * PGSIZE, true))
+				PANIC("large page: cannot map page");
+	vm_large_cnt++;
+	lock_release(&frame_table->frame_lock);
+	return true;
 }
 
-/* Find VA from spt and return page. On error, return NULL. */
-/* 가상 주소를 통해 SPT에서 페이지를 찾아 리턴합니다.
- * 에러가 발생하면 NULL을 리턴하세요 */
-struct page *
-spt_find_page(struct supplemental_page_table *spt, void *va)
+/* SWAP_IDX 슬롯을 스왑 인한 뒤, 바로 뒤 슬롯들 중 현재 프로세스의 페이지가 들어 있는 것을 미리 읽어 옵니다.
+ * 스왑 아웃 때 가상 주소가 이어지는 페이지를 이어진 슬롯에 두므로 순차 접근이면 다음 폴트들이 사라집니다.
+ * 추측으로 읽는 것이므로 빈 프레임이 low 워터마크보다 많을 때만, 교체 없이 읽습니다. */
+static void
+vm_swap_readahead(int swap_idx)
 {
-    ASSERT(spt != NULL);
-    // ASSERT(va != NULL);
-	if(va==NULL) return NULL;
+	struct supplemental_page_table *spt = &thread_current()->spt;
 
-	struct page temp;
-	temp.va = pg_round_down(va);
-	
-	struct hash_elem *e = hash_find(&spt->spt_hash, &temp.hash_elem);
-	
-	if (e == NULL)
-		return NULL;
-	else
-		return hash_entry(e, struct page, hash_elem);
-	
+	for (int i = 1; i <= SWAP_READAHEAD; i++)
+	{
+		if (palloc_user_free_pages() <= vm_low_watermark)
+			return;
+
+		void *va = anon_swap_slot_va(swap_idx + i);
+		if (va == NULL)
+			return;
+
+		struct page *page = spt_find_page(spt, va);
+		if (page == NULL || VM_TYPE(page->operations->type) != VM_ANON ||
+			page->frame != NULL || page->anon.swap_idx != swap_idx + i)
+			return;
+
+		if (!vm_do_claim_page(page))
+			return;
+	}
 }
 
+/* 아직 한 번도 채우지 않은, 실행 파일 세그먼트에서 내용을 읽어야 하는 페이지면 true를 반환합니다.
+ * 실행 파일 세그먼트는 lazy_load_segment로 채웁니다. mmap 페이지는 VMA에서 만들어 file_backed_swap_in()으로 채우므로 해당하지 않습니다. */
+static bool
+page_is_lazy_file(struct page *page)
+{
+	return VM_TYPE(page->operations->type) == VM_UNINIT &&
+		   page->uninit.init == lazy_load_segment &&
+		   page->uninit.aux != NULL && !page_is_zero_fill(page);
+}
 
-/* Insert PAGE into spt with validation. */
-bool spt_insert_page(struct supplemental_page_table *spt,
-					 struct page *page)
+/* 파일 페이지 폴트를 처리한 뒤, 같은 파일의 바로 다음 오프셋을 담는 이웃 페이지들을 미리 채우고 매핑합니다.
+ * VA는 방금 채운 페이지, INODE와 OFS는 그 페이지가 읽은 파일 위치, WINDOW는 채울 이웃 페이지 수입니다.
+ * 프로그램 시작이나 mmap 순차 접근에서 페이지마다 폴트가 나던 것을 최대 WINDOW 배 줄입니다.
+ * 이웃이 이미 채워졌거나 파일이 이어지지 않으면 멈추고, 교체 없이 빈 프레임이 있을 때만 채웁니다. */
+static void
+vm_fault_around(void *va, struct inode *inode, off_t ofs, int window)
 {
-	int succ = false;
-	ASSERT(page!=NULL);
-	struct hash_elem * e=hash_insert(&spt->spt_hash, &page->hash_elem);
-	if(e!=NULL) return succ; //실패했음
+	struct supplemental_page_table *spt = &thread_current()->spt;
 
-	succ=true;
-	return succ;
+	for (int i = 1; i <= window; i++)
+	{
+		if (palloc_user_free_pages() <= vm_low_watermark)
+			return;
+
+		void *next = va + i * PGSIZE;
+		struct page *page = spt_find_page(spt, next);
+		if (page == NULL)
+		{
+			/* mmap 구간은 아직 페이지 구조체가 없으므로 VMA에서 만듭니다. */
+			struct vma *vma = vma_find(spt, next);
+			if (vma == NULL || vma->file == NULL || file_get_inode(vma->file) != inode ||
+				vma->ofs + (next - vma->start) != ofs + i * PGSIZE)
+				return;
+			page = vma_materialize(vma, next);
+			if (page == NULL)
+				return;
+		}
+		else
+		{
+			if (!page_is_lazy_file(page))
+				return;
+			struct file_info *info = page->uninit.aux;
+			if (file_get_inode(info->file) != inode || info->ofs != ofs + i * PGSIZE)
+				return;
+		}
+
+		if (!vm_do_claim_page(page))
+			return;
+	}
 }
 
-void spt_remove_page(struct supplemental_page_table *spt, struct page *page)
+/* MADV_SEQUENTIAL 구간에서 VA를 폴트로 채운 뒤, readahead 폭보다 더 뒤에 있는 페이지 한 구간을 내려놓습니다.
+ * 폴트는 readahead 폭마다 한 번 나므로 매번 그만큼씩만 보면 지나간 페이지가 빠짐없이 내려갑니다. */
+static void
+vma_drop_behind(struct vma *vma, void *va)
 {
-	hash_delete(&spt->spt_hash, &page->hash_elem);	
-	// vm_dealloc_page(page); //<< 이거 쓰면 swap out~->swap in이 안될 것 같은데? 
+	size_t dist = (FAULT_AROUND_SEQ + 1) * PGSIZE;
 
+	if ((size_t)(va - vma->start) <= dist)
+		return;
+	void *end = va - dist;
+	void *start = (size_t)(end - vma->start) > dist ? end - dist : vma->start;
+	vma_drop_range(&thread_current()->spt, start, end);
 }
 
-/* Get the struct frame, that will be evicted. */
-static struct frame *
-vm_get_victim(void)
+/* [START, END) 중 아직 올라와 있지 않은 페이지를 한 번에 훑으며 채우고 매핑합니다.
+ * POPULATE가 false면 힌트이므로 fault-around처럼 교체 없이, 빈 프레임이 low 워터마크보다 많을 때만 채웁니다.
+ * true면 필요한 만큼 교체하며, 2MB로 정렬된 0 페이지 구간은 큰 페이지 하나로 올립니다. */
+static void
+vm_fill_range(void *start, void *end, bool populate)
 {
-	struct frame *victim;
-	/* TODO: 교체 정책을 여기서 구현해서 희생자 페이지 찾기 */
+	struct supplemental_page_table *spt = &thread_current()->spt;
 
-	ASSERT(list_empty(&frame_table->frame_list)==false);
-		
+	for (void *va = start; va < end; va += PGSIZE)
+	{
+		if (!populate && palloc_user_free_pages() <= vm_low_watermark)
+			return;
 
-	victim = list_entry(list_pop_front(&frame_table->frame_list), struct frame, frame_elem);
-	ASSERT(victim!=NULL);
+		struct page *page = spt_find_page(spt, va);
+		if (populate && vm_large_pages && (uint64_t)va % LARGE_PGSIZE == 0 &&
+			(uint64_t)(end - va) >= LARGE_PGSIZE && (page == NULL || page_is_zero_fill(page)) &&
+			vm_claim_large_page(va))
+		{
+			va += LARGE_PGSIZE - PGSIZE;
+			continue;
+		}
 
-	return victim;
+		if (page == NULL)
+		{
+			struct vma *vma = vma_find(spt, va);
+			if (vma == NULL)
+				continue;
+			page = vma_materialize(vma, va);
+			if (page == NULL)
+				return;
+		}
+		else if (page->frame != NULL)
+			continue;
+
+		if (!vm_do_claim_page(page))
+			return;
+	}
 }
 
-/* 한 페이지를 교체(evict)하고 해당 프레임을 반환합니다.
- * 에러가 발생하면 NULL을 반환합니다.*/
-static struct frame *
-vm_evict_frame(void)
+/* [START, END) 중 아직 올라와 있지 않은 페이지를 미리 읽어 매핑합니다 (MADV_WILLNEED). */
+void
+vm_prefetch(void *start, void *end)
 {
-	struct frame *victim  = vm_get_victim();
-	if(victim==NULL) return NULL;	
+	vm_fill_range(start, end, false);
+}
 
-	struct page *page =victim->page;
-	if (page) {
-		if (!swap_out(page))
-			return NULL;
-		pml4_clear_page(thread_current()->pml4, page->va);
-		// list_remove(&page->frame->frame_elem);
+/* [START, END)의 페이지를 모두 바로 올려 매핑합니다 (MAP_POPULATE).
+ * 이후 첫 접근 때마다 나던 폴트가 사라집니다. */
+void
+vm_populate(void *start, void *end)
+{
+	vm_fill_range(start, end, true);
+}
+
+/* 힙의 끝(break)을 NEW_BRK로 옮기고 새 끝을 반환합니다 (brk 시스템 콜).
+ * 힙은 break와 함께 늘고 주는 익명 VMA 하나로 기록합니다. 늘어난 구간의 페이지는 익명 mmap처럼
+ * 폴트가 나면 만들고, 줄어든 구간의 페이지는 바로 해제합니다.
+ * 힙은 스택 성장 구간(1MB) 아래까지만 자랄 수 있습니다.
+ * NEW_BRK가 NULL이거나 다른 매핑과 겹쳐 옮길 수 없으면 기존 끝을 그대로 반환합니다. */
+void *
+vm_brk(void *new_brk)
+{
+	struct supplemental_page_table *spt = &thread_current()->spt;
+	void *old_end = pg_round_up(spt->heap_brk);
+	void *new_end = pg_round_up(new_brk);
 
-		page->frame = NULL; // 연결 해제
+	if (new_brk == NULL || spt->heap_start == NULL || new_brk < spt->heap_start ||
+		(uint64_t)new_brk > USER_STACK - (1 << 20))
+		return spt->heap_brk;
 
-		return victim;
+	if (new_end > old_end)
+	{
+		if (vma_overlaps(spt, old_end, new_end) || spt_range_used(spt, old_end, new_end) ||
+			!vma_extend(spt, pg_round_up(spt->heap_start), old_end, new_end))
+			return spt->heap_brk;
 	}
-	return NULL;
+	else if (new_end < old_end)
+		vma_truncate(spt, new_end, old_end);
 
+	spt->heap_brk = new_brk;
+	return new_brk;
 }
 
-/* palloc()을 사용하여 프레임을 할당합니다.
- * 사용 가능한 페이지가 없으면 페이지를 교체(evict)하여 반환합니다.
- * 이 함수는 항상 유효한 주소를 반환합니다. 즉, 사용자 풀 메모리가 가득 차면,
- * 이 함수는 프레임을 교체하여 사용 가능한 메모리 공간을 확보합니다.*/
-static struct frame *
-vm_get_frame(void)
+/* VMA 안의 VA에 해당하는 파일 페이지 구조체를 만들어 SPT에 넣습니다. 내용은 아직 읽지 않습니다.
+ * 익명 매핑이면 0으로 채울 익명 페이지를 예약합니다. */
+static struct page *
+vma_materialize(struct vma *vma, void *va)
 {
-	struct frame *frame = malloc(sizeof(struct frame));
-	ASSERT(frame!=NULL);
-	frame->r_cnt=0;
+	if (vma->file == NULL)
+		return vm_alloc_page(VM_ANON, va, vma->writable) ? spt_find_page(&thread_current()->spt, va) : NULL;
 
-	frame->kva= palloc_get_page(PAL_USER | PAL_ZERO);
-	if(frame->kva==NULL){
-		struct frame * victim=vm_evict_frame(); //이 안에서 swap out
-		ASSERT(victim!=NULL);
-		frame->kva=victim->kva;
-		
-		free(victim );
-	}
-	frame->page=NULL;
+	if (!vm_alloc_page_with_initializer(VM_FILE, va, vma->writable, NULL, vma))
+		return NULL;
 
-	list_push_back(&frame_table->frame_list, &frame->frame_elem);
-	
-	ASSERT(frame != NULL);
-	ASSERT(frame->page == NULL);
-	ASSERT(frame->kva!=NULL);
-	return frame;
+	struct page *page = spt_find_page(&thread_current()->spt, va);
+	if (!page_transmute(page, NULL))
+		PANIC("vma: cannot create file page");
+	return page;
 }
 
 /* Growing the stack. */
-static void
+static bool
 vm_stack_growth(void *addr)
 {
 	/* 스택 최하단에 익명 페이지를 추가하여 사용
 	 * addr은 PGSIZE로 내림(정렬)하여 사용	 */
-	vm_alloc_page(VM_ANON, addr, true); // 스택 최하단에 익명 페이지 추가
+	return vm_alloc_page(VM_ANON, addr, true); // 스택 최하단에 익명 페이지 추가
 }
 
 /* Handle the fault on write_protected page */
+/* copy-on-write 폴트를 처리합니다.
+ * 다른 페이지와 프레임을 공유 중이면 새 프레임에 복사해서 가져가고,
+ * 혼자 남은 프레임이면 복사 없이 쓰기 권한만 되돌립니다. */
 static bool
 vm_handle_wp(struct page *page)
 {
-	
-	void * old_kva= page->frame->kva;
-	page->frame->r_cnt--;
+	uint64_t *pml4 = thread_current()->pml4;
 
-	struct frame * frame=vm_get_frame();
-	page->frame=frame;
-	frame->page=page;
+	/* 새 프레임을 얻다가 교체하면 filesys_lock을 잡을 수 있습니다. 유저 버퍼에 쓰는 시스템 콜은
+	 * 락 밖에서 복사하므로 이 폴트가 filesys_lock을 쥔 채 들어오는 일은 없어야 합니다. */
+	ASSERT(!lock_held_by_current_thread(&filesys_lock));
 
-	frame->r_cnt++;
+	lock_acquire(&frame_table->frame_lock);
+	page_wait_evict(page);
+	struct frame *old_frame = page->frame;
 
-	
-	if(!pml4_set_page(thread_current()->pml4, page->va, frame->kva, true)){
-		PANIC("TODO");
+	if (old_frame == NULL)
+	{
+		/* 락을 기다리는 사이에 교체되었다면 다음 폴트에서 다시 올립니다. */
+		lock_release(&frame_table->frame_lock);
+		return true;
+	}
+
+	/* zero 프레임은 마지막 매핑이라도 넘겨주지 않고 항상 새 프레임을 받습니다. */
+	if (old_frame->r_cnt == 1 && old_frame != &zero_frame)
+	{
+		if (!pml4_set_page(pml4, page->va, old_frame->kva, true))
+			PANIC("cow: cannot remap frame");
+		lock_release(&frame_table->frame_lock);
+		return true;
+	}
+
+	/* 복사가 끝나기 전에 원본 프레임이 교체되지 않도록 고정합니다. */
+	bool old_pinned = old_frame->pinned;
+	old_frame->pinned = true;
+
+	struct frame *frame = vm_get_frame();
+	if (frame == NULL)
+	{
+		old_frame->pinned = old_pinned;
+		lock_release(&frame_table->frame_lock);
+		return false;
 	}
-	memcpy(page->frame->kva, old_kva, PGSIZE);
+	if (old_frame != &zero_frame)
+		memcpy(frame->kva, old_frame->kva, PGSIZE);
+
+	frame_unmap_page(old_frame, page);
+	old_frame->pinned = old_pinned;
+	frame_map_page(frame, page);
 
+	if (!pml4_set_page(pml4, page->va, frame->kva, true))
+		PANIC("cow: cannot map new frame");
+
+	frame->pinned = false;
+	lock_release(&frame_table->frame_lock);
 	return true;
 }
 
@@ -270,14 +1569,66 @@ bool vm_try_handle_fault(struct intr_frame *f , void *addr ,
     }
 
 
+	/* 2MB 구간 전체가 아직 손대지 않은 0 페이지면 큰 페이지 하나로 한꺼번에 올립니다. */
+	if (page && vm_large_pages && page_is_zero_fill(page) && vm_claim_large_page(page->va))
+		return true;
+
+	/* 아직 쓰지 않은 0 페이지를 읽기만 하면 프레임을 할당하지 않습니다. */
+	if (page && !write && page_is_zero_fill(page))
+		return vm_map_zero_page(page);
+
 	if(page){
-		return vm_do_claim_page(page);
+		int swap_idx = -1;
+		if (VM_TYPE(page->operations->type) == VM_ANON && page->frame == NULL)
+			swap_idx = page->anon.swap_idx;
+		/* 채우고 나면 aux를 알 수 없으므로 파일 위치를 미리 기억해 둡니다. */
+		struct inode *inode = NULL;
+		off_t ofs = 0;
+		if (page_is_lazy_file(page)) {
+			struct file_info *info = page->uninit.aux;
+			inode = file_get_inode(info->file);
+			ofs = info->ofs;
+		}
+
+		if (!vm_do_claim_page(page))
+			return false;
+		if (swap_idx != -1)
+			vm_swap_readahead(swap_idx);
+		if (inode != NULL)
+			vm_fault_around(page->va, inode, ofs, FAULT_AROUND);
+		return true;
+	}
+
+	/* mmap 구간이면 이 페이지의 구조체를 만들고 파일에서 읽어 옵니다. */
+	struct vma *vma = vma_find(spt, addr);
+	if (vma != NULL) {
+		if (write && !vma->writable)
+			return false;
+		/* 익명 매핑은 VMA를 보고 큰 페이지나 zero 프레임으로 먼저 처리합니다. */
+		if (vma->file == NULL && vm_large_pages && vm_claim_large_page(pg_round_down(addr)))
+			return true;
+		page = vma_materialize(vma, pg_round_down(addr));
+		if (page == NULL)
+			return false;
+		if (vma->file == NULL)
+			return write ? vm_do_claim_page(page) : vm_map_zero_page(page);
+		if (!vm_do_claim_page(page))
+			return false;
+		if (vma->advice == VMA_NORMAL)
+			vm_fault_around(page->va, file_get_inode(vma->file), file_page_offset(page), FAULT_AROUND);
+		else if (vma->advice == VMA_SEQUENTIAL)
+		{
+			vm_fault_around(page->va, file_get_inode(vma->file), file_page_offset(page), FAULT_AROUND_SEQ);
+			/* 시스템 콜이 버퍼를 미리 채우는 중에는 앞쪽 버퍼 페이지를 내려놓지 않습니다. */
+			if (f != NULL && user)
+				vma_drop_behind(vma, page->va);
+		}
+		return true;
 	}
 
     if (page == NULL) {
         if (addr > rsp - PGSIZE && addr >= USER_STACK - (1 << 20) && addr < USER_STACK) {
-            vm_stack_growth(pg_round_down(addr));
-			return true;
+			return vm_stack_growth(pg_round_down(addr));
 		}
         
         return false;
@@ -290,7 +1641,7 @@ bool vm_try_handle_fault(struct intr_frame *f , void *addr ,
 void vm_dealloc_page(struct page *page)
 {
 	destroy(page);
-	free(page); 
+	kmem_cache_free(page_cachep, page);
 }
 
 /* VA에 할당된 페이지를 요구합니다 . */
@@ -304,25 +1655,72 @@ bool vm_claim_page(void *va)
 }
 
 /* PAGE를 요구하고 mmu를 설정합니다*/
+/* 읽기 전용 파일 페이지는 같은 (inode, 오프셋)의 프레임이 이미 있으면 읽지 않고 공유합니다. */
 static bool
 vm_do_claim_page(struct page *page)
 {
-	struct frame *frame = vm_get_frame();
+	struct share_key key;
+	struct frame *frame;
+
+	lock_acquire(&frame_table->frame_lock);
+	/* 교체 중이던 페이지면 끝날 때까지 기다립니다. 교체가 실패해 매핑이 되살아났으면 할 일이 없습니다. */
+	page_wait_evict(page);
+	if (page->frame != NULL)
+	{
+		lock_release(&frame_table->frame_lock);
+		return true;
+	}
+
+	bool shareable = page_share_key(page, &key);
+	if (shareable && (frame = share_table_find(&key)) != NULL)
+	{
+		if (VM_TYPE(page->operations->type) == VM_UNINIT && !page_transmute(page, frame->kva))
+		{
+			lock_release(&frame_table->frame_lock);
+			return false;
+		}
+		frame_map_page(frame, page);
+		if (!pml4_set_page(thread_current()->pml4, page->va, frame->kva, false))
+		{
+			/* 페이지는 채워진 상태로 두고 연결만 끊습니다. 다음 폴트에서 다시 공유를 시도합니다. */
+			frame_unmap_page(frame, page);
+			lock_release(&frame_table->frame_lock);
+			return false;
+		}
+		lock_release(&frame_table->frame_lock);
+		return true;
+	}
+
+	frame = vm_get_frame();
+	if (frame == NULL)
+	{
+		lock_release(&frame_table->frame_lock);
+		return false;
+	}
 	
 	/* Set links */
-	frame->page = page;
-	page->frame = frame;
-	
-	frame->r_cnt++;
+	frame_map_page(frame, page);
+	lock_release(&frame_table->frame_lock);
 
 	/* TODO: Insert page table entry to map page's VA to frame's PA. */
 	if(!pml4_set_page(thread_current()->pml4, page->va, frame->kva, page->writable)){
-		// swap-out? 
-		PANIC("TODO");
+		/* 페이지 테이블을 만들 커널 페이지가 없으면 프레임을 돌려주고 실패합니다. */
+		lock_acquire(&frame_table->frame_lock);
+		frame_unmap_page(frame, page);
+		vm_free_frame(frame);
+		lock_release(&frame_table->frame_lock);
+		return false;
 	}
 	
-
-	return swap_in(page, frame->kva);
+	/* 내용을 다 채운 뒤에야 교체 대상이 되고, 다른 프로세스와 공유할 수 있습니다. */
+	bool succ = swap_in(page, frame->kva);
+
+	lock_acquire(&frame_table->frame_lock);
+	if (succ && shareable)
+		share_table_insert(frame, &key);
+	frame->pinned = false;
+	lock_release(&frame_table->frame_lock);
+	return succ;
 }
 
 bool is_less(const struct hash_elem *a, const struct hash_elem *b, void *aux){
@@ -341,6 +1739,10 @@ size_t page_hash(const struct hash_elem *e, void * aux){
 /* Initialize new supplemental page table */
 void supplemental_page_table_init(struct supplemental_page_table *spt)
 {
+	list_init(&spt->vmas);
+	spt->heap_start = spt->heap_brk = NULL;
+	spt->rss = spt->ws_size = spt->ws_cur = spt->swap_cnt = 0;
+	spt->ws_gen = 0;
 	if(!hash_init(&spt->spt_hash, page_hash, is_less, NULL))
 		return;
 }
@@ -352,12 +1754,16 @@ static void *duplicate_aux(struct page *src_page, enum vm_type type)
 	struct file_info *src_info;
     if (type == VM_UNINIT)
         src_info = (struct file_info *)src_page->uninit.aux;
-    else if (type == VM_FILE)
-        src_info = (struct file_info *)src_page->file.aux;
+    else if (type == VM_ANON)
+        src_info = src_page->anon.backing;
     else
         return NULL; // 처리 불가
 
-    struct file_info *dst_info = malloc(sizeof(struct file_info));
+    if (src_info == NULL)
+        return NULL; // 내용 없이 0으로 채워질 페이지
+
+    struct file_info *dst_info = kmem_cache_alloc(file_info_cachep);
+    ASSERT(dst_info != NULL);
 
     dst_info->file = file_reopen(src_info->file);
     dst_info->ofs = src_info->ofs;
@@ -365,93 +1771,137 @@ static void *duplicate_aux(struct page *src_page, enum vm_type type)
     dst_info->read_bytes = src_info->read_bytes;
     dst_info->zero_bytes = src_info->zero_bytes;
     dst_info->writable = src_info->writable;
-    dst_info->mmap_length = src_info->mmap_length;
     return dst_info;
    
 }
 
-bool page_table_copy(struct page* src_page, void *va){
-	struct page *page= spt_find_page(&thread_current()->spt, va);
-	if(page==NULL) return false;
+/* DST를 uninit 상태에서 실제 타입(anon/file)으로 바꿉니다.
+ * initializer만 실행하고 init 콜백(lazy_load_segment)은 부르지 않으므로 디스크 I/O가 없습니다. */
+static bool
+page_transmute(struct page *dst, void *kva)
+{
+	ASSERT(VM_TYPE(dst->operations->type) == VM_UNINIT);
+	enum vm_type type = dst->uninit.type;
+	vm_initializer *init = dst->uninit.init;
+	void *aux = dst->uninit.aux;
 
-	if(page->frame == NULL){
-		page->frame=src_page->frame;
-		page->writable=src_page->writable;
-		src_page->frame->r_cnt++;
-		
-	}
+	if (!dst->uninit.page_initializer(dst, type, kva))
+		return false;
+	/* 공유 프레임을 받은 실행 파일 페이지도 uninit_initialize()처럼 원본 위치를 넘겨받습니다. */
+	if (VM_TYPE(type) == VM_ANON && init == lazy_load_segment)
+		dst->anon.backing = aux;
+	return true;
+}
 
-	if(!pml4_set_page(thread_current()->pml4, page->va, src_page->frame->kva, false)){
-		PANIC("TODO");
-	}
+/* fork 시 SRC가 가진 내용을 DST와 공유합니다 (copy-on-write).
+ * 프레임에 올라와 있으면 DST를 읽기 전용으로 매핑하고 r_cnt를 올리며,
+ * SRC의 PTE는 __do_fork()가 복사 전에 한꺼번에 읽기 전용으로 바꿔 둡니다.
+ * 스왑 아웃된 익명 페이지는 스왑 슬롯의 참조 수만 올립니다.
+ * 처음 쓰는 쪽이 vm_handle_wp()에서 복사본을 가져갑니다.
+ * 공유할 내용이 없으면 false를 반환하고, 호출자가 lazy 페이지로 처리합니다. */
+static bool
+page_share_cow(struct page *dst, struct page *src)
+{
+	bool shared = false;
 
-	return swap_in(page, src_page->frame->kva);
+	/* pageout 데몬이 부모 프레임을 내보내는 중일 수 있으므로 락 안에서 상태를 봅니다. */
+	ASSERT(lock_held_by_current_thread(&frame_table->frame_lock));
+	page_wait_evict(src);
+	struct frame *frame = src->frame;
+	if (frame != NULL)
+	{
+		if (!page_transmute(dst, frame->kva) ||
+			!pml4_set_page(dst->owner->pml4, dst->va, frame->kva, false))
+			PANIC("fork: cannot share frame");
+		frame_map_page(frame, dst);
+		shared = true;
+	}
+	else if (page_get_type(src) == VM_ANON && src->anon.swap_idx != -1)
+	{
+		if (!page_transmute(dst, NULL))
+			PANIC("fork: cannot share swap slot");
+		anon_swap_share(dst, src);
+		shared = true;
+	}
+	else if (page_get_type(src) == VM_ANON && src->anon.backing != NULL)
+	{
+		/* 버려진 실행 파일 페이지는 자식도 파일에서 다시 읽도록 lazy 페이지로 만듭니다. */
+		ASSERT(VM_TYPE(dst->operations->type) == VM_UNINIT);
+		dst->uninit.init = lazy_load_segment;
+		dst->uninit.aux = duplicate_aux(src, VM_ANON);
+		shared = true;
+	}
+	return shared;
 }
 
+/* 부모(SRC)의 SPT를 자식(DST)에게 복사합니다.
+ * 페이지 내용은 복사하지 않고 공유하므로 비용은 페이지 수에만 비례합니다.
+ * 부모의 프레임과 PTE가 바뀌지 않도록 frame_lock을 잡고 호출해야 합니다. */
 bool supplemental_page_table_copy(struct supplemental_page_table *dst , struct supplemental_page_table *src )
 {
-   struct hash_iterator i;
-   hash_first(&i, &src->spt_hash);
-   struct thread *cur = thread_current();
-
-   while (hash_next(&i))
-   {
-      // src_page 정보
-      struct page *src_page = hash_entry(hash_cur(&i), struct page, hash_elem);
-      enum vm_type type = src_page->operations->type;
-      void *upage = src_page->va;
-      bool writable = src_page->writable;
-
-      /* 1) type이 uninit이면 */
-      if (type == VM_UNINIT)
-      { // 부모의 예약된 타입을 가져옴 
-		 enum vm_type reserved_type = src_page->uninit.type;
-         vm_initializer *init = src_page->uninit.init;
-         void *aux = duplicate_aux(src_page,VM_UNINIT);
-		 ASSERT(aux!=NULL);
-		 
-         if(!vm_alloc_page_with_initializer(reserved_type, upage, writable, init, aux))
-		 	return false;
-         continue;
-      }
-
-      /* 2) type이 file-backed이면 */
-	  else if (type == VM_FILE)
-	  {
-	  
-		  struct file_info *aux = duplicate_aux(src_page, VM_FILE);
-		  ASSERT(aux!=NULL);
-
-		  if (!vm_alloc_page_with_initializer(type, upage, writable, lazy_load_segment, aux))
-			  return false;
-	  
-		  if (!vm_claim_page(upage))
-			  return false;
-	  
-		  continue;
-	  }
-	  else if(type==VM_ANON){
-		  // 3. type이 anon 이면 
-		  if (!vm_alloc_page(type, upage, writable)) // uninit page 생성 & 초기화
-			 // init(lazy_load_segment)는 page_fault가 발생할때 호출됨
-			 // 지금 만드는 페이지는 page_fault가 일어날 때까지 기다리지 않고 바로 내용을 넣어줘야 하므로 필요 없음
-			 return false;
-		
-			if(!page_table_copy(src_page, upage))
-				return false;
+	struct hash_iterator i;
 
-			// 매핑된 프레임에 내용 로딩
-			struct page *dst_page = spt_find_page(dst, upage);
-			if(src_page->frame != NULL)
-				memcpy(dst_page->frame->kva, src_page->frame->kva, PGSIZE);
-	}
-	  else{
+	ASSERT(lock_held_by_current_thread(&frame_table->frame_lock));
+
+	/* mmap 구간을 먼저 복사해야 파일 페이지가 자식의 VMA를 가리킬 수 있습니다. */
+	if (!vma_copy(dst, src))
 		return false;
-	  }
+	dst->heap_start = src->heap_start;
+	dst->heap_brk = src->heap_brk;
+
+	hash_first(&i, &src->spt_hash);
+	while (hash_next(&i))
+	{
+		// src_page 정보
+		struct page *src_page = hash_entry(hash_cur(&i), struct page, hash_elem);
+		enum vm_type type = src_page->operations->type;
+		void *upage = src_page->va;
+		bool writable = src_page->writable;
+
+		/* 1) type이 uninit이면 부모와 같은 initializer로 예약만 합니다 */
+		if (type == VM_UNINIT)
+		{
+			enum vm_type reserved_type = src_page->uninit.type;
+			vm_initializer *init = src_page->uninit.init;
+			void *aux = duplicate_aux(src_page, VM_UNINIT);
+			ASSERT(aux != NULL || VM_TYPE(reserved_type) == VM_ANON);
+
+			if (!vm_alloc_page_with_initializer(reserved_type, upage, writable, init, aux))
+				return false;
+			continue;
+		}
+
+		/* 2) file-backed 페이지는 올라와 있을 때만 프레임을 공유합니다.
+		 *    아니면 자식이 접근할 때 자기 VMA에서 새로 만듭니다. */
+		if (type == VM_FILE)
+		{
+			struct vma *vma = vma_find(dst, upage);
+			ASSERT(vma != NULL);
+
+			if (!vm_alloc_page_with_initializer(type, upage, writable, NULL, vma))
+				return false;
 
+			struct page *dst_page = spt_find_page(dst, upage);
+			if (!page_share_cow(dst_page, src_page))
+			{
+				spt_remove_page(dst, dst_page);
+				kmem_cache_free(page_cachep, dst_page);
+			}
+			continue;
+		}
+		/* 3) anon 페이지는 프레임이나 스왑 슬롯을 공유합니다 */
+		else if (type == VM_ANON)
+		{
+			if (!vm_alloc_page(type, upage, writable))
+				return false;
+		}
+		else
+			return false;
 
-   }
-    return true;
+		/* 공유할 내용이 없으면 uninit으로 남겨두고 첫 접근 때 채웁니다. */
+		page_share_cow(spt_find_page(dst, upage), src_page);
+	}
+	return true;
 }
 
 void page_desturctor(struct hash_elem *e, void * aux){
@@ -469,5 +1919,12 @@ void supplemental_page_table_kill(struct supplemental_page_table *spt)
 	그럼 내부 구조가 바뀌어버리니 iterator가 안전하게 동작 하지 않음 
 	*/
 	// hash_destroy(&spt->spt_hash, page_desturctor);
+
+	/* 사용자 매핑을 한 번에 내리고 TLB도 한 번만 비웁니다.
+	 * 각 페이지의 destroy는 이미 내려간 PTE를 만나므로 따로 무효화하지 않습니다. */
+	uint64_t *pml4 = thread_current()->pml4;
+	if (pml4 != NULL)
+		pml4_clear_range(pml4, NULL, (void *)KERN_BASE);
 	hash_clear(&spt->spt_hash, page_desturctor);
+	vma_kill(spt);
 }
\ No newline at end of file
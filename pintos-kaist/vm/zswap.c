@@ -0,0 +1,383 @@
+/* zswap.c: 스왑 디스크 앞에 두는 압축 메모리 캐시.
+ *
+ * 스왑 아웃되는 익명 페이지를 LZ 계열 압축기로 줄여 커널 풀의 아레나에 보관합니다.
+ * 아레나는 원형 버퍼라서 항상 head에 붙여 쓰고, 가득 차면 tail의 가장 오래된 항목부터
+ * 압축을 풀어 그 슬롯의 디스크 위치에 씁니다. 다시 쓰인 항목이나 무효화된 항목의 공간은
+ * tail이 지나갈 때 회수됩니다.
+ *
+ * 스왑 슬롯 번호는 anon.c가 그대로 관리하고, 여기서는 슬롯의 내용이 디스크 대신 메모리에
+ * 있는지만 기록합니다. 따라서 fork 공유, readahead 같은 슬롯 단위 동작은 바뀌지 않습니다.
+ * 모두 0인 페이지는 공간을 쓰지 않고 표시만 남깁니다. */
+
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "vm/zswap.h"
+#include "devices/disk.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* 이보다 크게 압축되는 페이지는 보관할 가치가 없으므로 바로 디스크에 씁니다. */
+#define ZSWAP_MAX_LEN (PGSIZE * 3 / 4)
+#define ZSWAP_SECTORS (PGSIZE / DISK_SECTOR_SIZE)
+
+/* zswap_ofs[]의 특수 값 */
+#define ZSWAP_NONE 0			/* 메모리에 없음, 디스크에 있음 */
+#define ZSWAP_ZERO UINT32_MAX	/* 모두 0인 페이지 */
+
+/* 아레나의 항목 머리. 뒤에 압축된 내용이 8바이트 단위로 이어집니다. */
+struct zswap_hdr
+{
+	uint32_t slot;			/* 스왑 슬롯, 채움용 빈칸이면 ZSWAP_PAD */
+	uint32_t len;			/* 압축된 길이 (빈칸이면 머리를 뺀 크기) */
+};
+#define ZSWAP_PAD UINT32_MAX
+
+static struct disk *zswap_disk;
+static struct lock zswap_lock;
+static uint8_t *arena;			/* 원형 버퍼, NULL이면 zswap을 쓰지 않음 */
+static size_t arena_size;
+static size_t head, tail, used;	/* 바이트 단위 위치와 사용량 */
+static uint32_t *zswap_ofs;		/* 슬롯마다 (항목 위치 + 1) 또는 특수 값 */
+static uint8_t *bounce;			/* 압축/해제용 임시 페이지 */
+
+/* 통계 */
+static size_t stored_cnt, zero_cnt, reject_cnt, writeback_cnt, hit_cnt;
+
+static size_t lz_compress(const uint8_t *src, uint8_t *dst, size_t cap);
+static bool lz_decompress(const uint8_t *src, size_t len, uint8_t *dst);
+static void zswap_make_room(size_t size);
+static size_t entry_size(const struct zswap_hdr *hdr);
+
+/* SWAP_DISK의 SLOT_CNT개 슬롯 앞에 캐시를 둡니다.
+ * 아레나는 유저 풀의 1/8 크기로 커널 풀에서 가져오고, 못 가져오면 캐시 없이 동작합니다. */
+void
+zswap_init(struct disk *swap_disk, size_t slot_cnt)
+{
+	size_t page_cnt = palloc_user_pages() / 8;
+
+	zswap_disk = swap_disk;
+	lock_init(&zswap_lock);
+	head = tail = used = 0;
+
+	if (page_cnt < 2)
+		page_cnt = 2;
+	zswap_ofs = calloc(slot_cnt, sizeof *zswap_ofs);
+	bounce = palloc_get_page(0);
+	arena = palloc_get_multiple(0, page_cnt);
+	if (zswap_ofs == NULL || bounce == NULL || arena == NULL)
+	{
+		arena = NULL;
+		return;
+	}
+	arena_size = page_cnt * PGSIZE;
+}
+
+/* 모두 0인 페이지면 true를 반환합니다. */
+static bool
+page_is_zero(const void *kva)
+{
+	const uint64_t *p = kva;
+	for (size_t i = 0; i < PGSIZE / sizeof *p; i++)
+		if (p[i] != 0)
+			return false;
+	return true;
+}
+
+/* KVA의 내용을 SLOT으로 압축해 보관합니다.
+ * 압축이 잘 안 되거나 캐시가 없으면 false를 반환하고, 호출자가 디스크에 씁니다. */
+bool
+zswap_store(size_t slot, const void *kva)
+{
+	if (arena == NULL)
+		return false;
+
+	lock_acquire(&zswap_lock);
+	ASSERT(zswap_ofs[slot] == ZSWAP_NONE);
+	if (page_is_zero(kva))
+	{
+		zswap_ofs[slot] = ZSWAP_ZERO;
+		zero_cnt++;
+		lock_release(&zswap_lock);
+		return true;
+	}
+
+	size_t len = lz_compress(kva, bounce, ZSWAP_MAX_LEN);
+	if (len == 0)
+	{
+		reject_cnt++;
+		lock_release(&zswap_lock);
+		return false;
+	}
+
+	size_t size = sizeof(struct zswap_hdr) + ROUND_UP(len, 8);
+	struct zswap_hdr *hdr;
+
+	/* 끝에 남은 공간이 모자라면 빈칸으로 채우고 처음으로 돌아갑니다. */
+	if (arena_size - head < size)
+	{
+		size_t pad = arena_size - head;
+		zswap_make_room(pad);
+		/* 모두 비워졌다면 head가 이미 처음으로 돌아와 있습니다. */
+		if (head != 0)
+		{
+			hdr = (struct zswap_hdr *) (arena + head);
+			hdr->slot = ZSWAP_PAD;
+			hdr->len = pad - sizeof *hdr;
+			used += pad;
+			head = 0;
+		}
+	}
+
+	zswap_make_room(size);
+	hdr = (struct zswap_hdr *) (arena + head);
+	hdr->slot = slot;
+	hdr->len = len;
+	memcpy(hdr + 1, bounce, len);
+	zswap_ofs[slot] = head + 1;
+	used += size;
+	head = (head + size) % arena_size;
+	stored_cnt++;
+	lock_release(&zswap_lock);
+	return true;
+}
+
+/* SLOT의 내용이 캐시에 있으면 KVA로 풀어 놓고 true를 반환합니다.
+ * fork로 공유된 슬롯일 수 있으므로 항목은 zswap_invalidate()까지 남겨 둡니다. */
+bool
+zswap_load(size_t slot, void *kva)
+{
+	if (arena == NULL)
+		return false;
+
+	lock_acquire(&zswap_lock);
+	uint32_t ofs = zswap_ofs[slot];
+	if (ofs == ZSWAP_NONE)
+	{
+		lock_release(&zswap_lock);
+		return false;
+	}
+
+	if (ofs == ZSWAP_ZERO)
+		memset(kva, 0, PGSIZE);
+	else
+	{
+		struct zswap_hdr *hdr = (struct zswap_hdr *) (arena + ofs - 1);
+		ASSERT(hdr->slot == slot);
+		if (!lz_decompress((uint8_t *) (hdr + 1), hdr->len, kva))
+			PANIC("zswap: corrupted entry for slot %zu", slot);
+	}
+	hit_cnt++;
+	lock_release(&zswap_lock);
+	return true;
+}
+
+/* 비워진 SLOT의 항목을 버립니다. 공간은 tail이 지나갈 때 회수됩니다. */
+void
+zswap_invalidate(size_t slot)
+{
+	if (arena == NULL)
+		return;
+
+	lock_acquire(&zswap_lock);
+	zswap_ofs[slot] = ZSWAP_NONE;
+	lock_release(&zswap_lock);
+}
+
+/* 캐시 통계를 출력합니다. */
+void
+zswap_print_stats(void)
+{
+	if (arena == NULL)
+		return;
+	printf("zswap: %zu stored, %zu zero, %zu rejected, %zu written back, %zu hits\n",
+		   stored_cnt, zero_cnt, reject_cnt, writeback_cnt, hit_cnt);
+}
+
+/* 아레나 항목 HDR이 차지하는 바이트 수 */
+static size_t
+entry_size(const struct zswap_hdr *hdr)
+{
+	if (hdr->slot == ZSWAP_PAD)
+		return sizeof *hdr + hdr->len;
+	return sizeof *hdr + ROUND_UP(hdr->len, 8);
+}
+
+/* head부터 SIZE 바이트가 비도록 가장 오래된 항목들을 디스크로 내보냅니다.
+ * zswap_lock을 잡고 호출해야 합니다. */
+static void
+zswap_make_room(size_t size)
+{
+	ASSERT(size <= arena_size);
+
+	while (arena_size - used < size)
+	{
+		struct zswap_hdr *hdr = (struct zswap_hdr *) (arena + tail);
+		size_t esize = entry_size(hdr);
+
+		/* 아직 유효한 항목이면 디스크의 자기 슬롯에 씁니다. */
+		if (hdr->slot != ZSWAP_PAD && zswap_ofs[hdr->slot] == tail + 1)
+		{
+			if (!lz_decompress((uint8_t *) (hdr + 1), hdr->len, bounce))
+				PANIC("zswap: corrupted entry for slot %u", hdr->slot);
+			for (int i = 0; i < ZSWAP_SECTORS; i++)
+				disk_write(zswap_disk, hdr->slot * ZSWAP_SECTORS + i,
+						   bounce + i * DISK_SECTOR_SIZE);
+			zswap_ofs[hdr->slot] = ZSWAP_NONE;
+			writeback_cnt++;
+		}
+		tail = (tail + esize) % arena_size;
+		used -= esize;
+	}
+	if (used == 0)
+		head = tail = 0;
+}
+
+/* LZ4 블록 형식을 단순화한 압축기.
+ * 시퀀스마다 토큰 1바이트(상위 4비트 리터럴 길이, 하위 4비트 매치 길이 - 4),
+ * 리터럴, 2바이트 거리, 길이 확장 바이트가 이어집니다. 마지막 시퀀스는 리터럴만 가집니다. */
+#define LZ_HASH_BITS 12
+#define LZ_MIN_MATCH 4
+#define LZ_LAST_LITERALS 8
+static uint16_t lz_table[1 << LZ_HASH_BITS];
+
+static uint32_t
+lz_read32(const uint8_t *p)
+{
+	uint32_t v;
+	memcpy(&v, p, sizeof v);
+	return v;
+}
+
+/* LEN을 토큰의 4비트 필드 뒤에 이어지는 확장 바이트로 씁니다. 넘치면 NULL을 반환합니다. */
+static uint8_t *
+lz_put_len(uint8_t *op, uint8_t *oend, size_t len)
+{
+	if (len < 15)
+		return op;
+	for (len -= 15; len >= 255; len -= 255)
+	{
+		if (op >= oend)
+			return NULL;
+		*op++ = 255;
+	}
+	if (op >= oend)
+		return NULL;
+	*op++ = len;
+	return op;
+}
+
+/* SRC 한 페이지를 DST에 압축하고 길이를 반환합니다. CAP을 넘으면 0을 반환합니다.
+ * zswap_lock을 잡고 호출해야 합니다 (lz_table 공유). */
+static size_t
+lz_compress(const uint8_t *src, uint8_t *dst, size_t cap)
+{
+	const uint8_t *ip = src, *anchor = src;
+	const uint8_t *end = src + PGSIZE;
+	const uint8_t *match_limit = end - LZ_LAST_LITERALS;
+	uint8_t *op = dst, *oend = dst + cap;
+
+	memset(lz_table, 0, sizeof lz_table);
+	while (ip < match_limit)
+	{
+		uint32_t seq = lz_read32(ip);
+		uint32_t h = (seq * 2654435761u) >> (32 - LZ_HASH_BITS);
+		const uint8_t *ref = src + lz_table[h];
+		lz_table[h] = ip - src;
+		if (ref >= ip || lz_read32(ref) != seq)
+		{
+			ip++;
+			continue;
+		}
+
+		size_t mlen = LZ_MIN_MATCH;
+		while (ip + mlen < match_limit && ref[mlen] == ip[mlen])
+			mlen++;
+
+		size_t lit = ip - anchor;
+		if (op + 1 + lit + 2 > oend)
+			return 0;
+		uint8_t *token = op++;
+		*token = (lit < 15 ? lit : 15) << 4 | (mlen - LZ_MIN_MATCH < 15 ? mlen - LZ_MIN_MATCH : 15);
+		if ((op = lz_put_len(op, oend, lit)) == NULL || op + lit + 2 > oend)
+			return 0;
+		memcpy(op, anchor, lit);
+		op += lit;
+		*op++ = (ip - ref) & 0xff;
+		*op++ = (ip - ref) >> 8;
+		if ((op = lz_put_len(op, oend, mlen - LZ_MIN_MATCH)) == NULL)
+			return 0;
+
+		ip += mlen;
+		anchor = ip;
+	}
+
+	size_t lit = end - anchor;
+	if (op + 1 > oend)
+		return 0;
+	*op++ = (lit < 15 ? lit : 15) << 4;
+	if ((op = lz_put_len(op, oend, lit)) == NULL || op + lit > oend)
+		return 0;
+	memcpy(op, anchor, lit);
+	op += lit;
+	return op - dst;
+}
+
+/* 확장 바이트를 읽어 4비트 필드 값 LEN에 더합니다. */
+static const uint8_t *
+lz_get_len(const uint8_t *ip, const uint8_t *iend, size_t *len)
+{
+	if (*len < 15)
+		return ip;
+	uint8_t b;
+	do
+	{
+		if (ip >= iend)
+			return NULL;
+		b = *ip++;
+		*len += b;
+	} while (b == 255);
+	return ip;
+}
+
+/* LEN 바이트짜리 압축 데이터 SRC를 DST 한 페이지로 풉니다. 형식이 깨졌으면 false를 반환합니다. */
+static bool
+lz_decompress(const uint8_t *src, size_t len, uint8_t *dst)
+{
+	const uint8_t *ip = src, *iend = src + len;
+	uint8_t *op = dst, *oend = dst + PGSIZE;
+
+	while (ip < iend)
+	{
+		uint8_t token = *ip++;
+		size_t lit = token >> 4;
+		if ((ip = lz_get_len(ip, iend, &lit)) == NULL ||
+			lit > (size_t) (iend - ip) || lit > (size_t) (oend - op))
+			return false;
+		memcpy(op, ip, lit);
+		ip += lit;
+		op += lit;
+		if (ip == iend)
+			break;
+
+		if (iend - ip < 2)
+			return false;
+		size_t dist = ip[0] | ip[1] << 8;
+		ip += 2;
+		size_t mlen = token & 15;
+		if ((ip = lz_get_len(ip, iend, &mlen)) == NULL)
+			return false;
+		mlen += LZ_MIN_MATCH;
+		if (dist == 0 || dist > (size_t) (op - dst) || mlen > (size_t) (oend - op))
+			return false;
+
+		/* 겹치는 복사(dist < mlen)가 반복 패턴을 만들어 내므로 한 바이트씩 복사합니다. */
+		const uint8_t *ref = op - dist;
+		while (mlen-- > 0)
+			*op++ = *ref++;
+	}
+	return op == oend;
+}